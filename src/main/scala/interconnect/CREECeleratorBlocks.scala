@@ -1,26 +1,38 @@
 package interconnect
 
 import chisel3._
+import chisel3.core.dontTouch
 import chisel3.util._
 import dspblocks._
 import freechips.rocketchip.amba.axi4stream._
 import freechips.rocketchip.config.Parameters
 import freechips.rocketchip.diplomacy._
+import freechips.rocketchip.interrupts._
 import freechips.rocketchip.regmapper._
 import freechips.rocketchip.tilelink._
 import freechips.rocketchip.subsystem.BaseSubsystem
 
+/**
+  * Offset of the burst window in the queue address space. Every slot of the
+  * window maps to the queue, so the n-th beat of a burst moves the n-th entry.
+  */
+object QueueBurstWindow {
+  val offset = 0x40
+}
+
 /**
   * The memory interface writes entries into the queue.
   * They stream out the streaming interface
   * @param depth number of entries in the queue
   * @param streamParameters parameters for the stream node
+  * @param burstBytes size of the burst window, in bytes
   * @param p
   */
 abstract class WriteQueue
 (
   val depth: Int = 16,
-  val streamParameters: AXI4StreamMasterParameters = AXI4StreamMasterParameters()
+  val streamParameters: AXI4StreamMasterParameters = AXI4StreamMasterParameters(),
+  val burstBytes: Int = 64
 )(implicit p: Parameters) extends LazyModule with HasCSR {
   // stream node, output only
   val streamNode = AXI4StreamMasterNode(streamParameters)
@@ -41,11 +53,28 @@ abstract class WriteQueue
     out.bits.last := false.B
     queue.io.deq.ready := out.ready
 
+    // Slot 0 is the single-entry register at 0x0, the others form the burst
+    // window. The register node serves one beat per cycle, so at most one
+    // slot is written at a time.
+    val burstBeats = burstBytes / ((width+7)/8)
+    val enqValid = Wire(Vec(burstBeats + 1, Bool()))
+    val enqBits = Wire(Vec(burstBeats + 1, UInt(width.W)))
+    queue.io.enq.valid := enqValid.asUInt.orR
+    queue.io.enq.bits := Mux1H(enqValid, enqBits)
+
+    def enqField(i: Int) = RegField.w(width, RegWriteFn((valid, data) => {
+      enqValid(i) := valid
+      enqBits(i) := data
+      queue.io.enq.ready
+    }))
+
     regmap(
       // each write adds an entry to the queue
-      0x0 -> Seq(RegField.w(width, queue.io.enq)),
+      0x0 -> Seq(enqField(0)),
       // read the number of entries in the queue
       (width+7)/8 -> Seq(RegField.r(width, queue.io.count)),
+      // each beat written to the window adds an entry to the queue
+      QueueBurstWindow.offset -> (1 to burstBeats).map(enqField)
     )
   }
 }
@@ -55,6 +84,7 @@ abstract class WriteQueue
   * @param depth number of entries in the queue
   * @param csrAddress address range for peripheral
   * @param beatBytes beatBytes of TL interface
+  * @param burstBytes largest Put burst accepted by burstNode
   * @param p
   */
 class TLWriteQueue
@@ -62,7 +92,8 @@ class TLWriteQueue
   depth: Int = 16,
   csrAddress: AddressSet = AddressSet(0x2000, 0xff),
   beatBytes: Int = 8,
-)(implicit p: Parameters) extends WriteQueue(depth) with TLHasCSR {
+  burstBytes: Int = 64
+)(implicit p: Parameters) extends WriteQueue(depth, burstBytes = burstBytes) with TLHasCSR {
   val devname = "tlQueueIn"
   val devcompat = Seq("ucb-art", "dsptools")
   val device = new SimpleDevice(devname, devcompat) {
@@ -73,6 +104,9 @@ class TLWriteQueue
   }
   // make diplomatic TL node for regmap
   override val mem = Some(TLRegisterNode(address = Seq(csrAddress), device = device, beatBytes = beatBytes))
+  // multi-beat bursts are split into consecutive single-beat register writes
+  val burstNode = TLFragmenter(beatBytes, burstBytes)
+  mem.get := burstNode
 }
 
 /**
@@ -80,12 +114,14 @@ class TLWriteQueue
   * The memory interface can read elements out of the queue.
   * @param depth number of entries in the queue
   * @param streamParameters parameters for the stream node
+  * @param burstBytes size of the burst window, in bytes
   * @param p
   */
 abstract class ReadQueue
 (
   val depth: Int = 16,
-  val streamParameters: AXI4StreamSlaveParameters = AXI4StreamSlaveParameters()
+  val streamParameters: AXI4StreamSlaveParameters = AXI4StreamSlaveParameters(),
+  val burstBytes: Int = 64
 )(implicit p: Parameters) extends LazyModule with HasCSR {
   val streamNode = AXI4StreamSlaveNode(streamParameters)
 
@@ -99,6 +135,9 @@ abstract class ReadQueue
     val width = in.params.n * 8
     // instantiate a queue
     val queue = Module(new Queue(UInt(in.params.dataBits.W), depth))
+    // occupancy, exported for the read queue watermark interrupt
+    val queueCount = IO(Output(UInt(log2Ceil(depth + 1).W)))
+    queueCount := queue.io.count
     // connect streaming input to queue input
     queue.io.enq.valid := in.valid
     queue.io.enq.bits := in.bits.data
@@ -106,11 +145,24 @@ abstract class ReadQueue
     in.bits.last := false.B
     in.ready := queue.io.enq.ready
 
+    // Slot 0 is the single-entry register at 0x0, the others form the burst
+    // window. At most one slot is read per cycle.
+    val burstBeats = burstBytes / ((width+7)/8)
+    val deqReady = Wire(Vec(burstBeats + 1, Bool()))
+    queue.io.deq.ready := deqReady.asUInt.orR
+
+    def deqField(i: Int) = RegField.r(width, RegReadFn(ready => {
+      deqReady(i) := ready
+      (queue.io.deq.valid, queue.io.deq.bits)
+    }))
+
     regmap(
       // each read removes an entry from the queue
-      0x0 -> Seq(RegField.r(width, queue.io.deq)),
+      0x0 -> Seq(deqField(0)),
       // read the number of entries in the queue
       (width+7)/8 -> Seq(RegField.r(width, queue.io.count)),
+      // each beat read from the window removes an entry from the queue
+      QueueBurstWindow.offset -> (1 to burstBeats).map(deqField)
     )
 
   }
@@ -121,14 +173,16 @@ abstract class ReadQueue
   * @param depth number of entries in the queue
   * @param csrAddress address range
   * @param beatBytes beatBytes of TL interface
+  * @param burstBytes largest Get burst accepted by burstNode
   * @param p
   */
 class TLReadQueue
 (
   depth: Int = 16,
   csrAddress: AddressSet = AddressSet(0x2100, 0xff),
-  beatBytes: Int = 8
-)(implicit p: Parameters) extends ReadQueue(depth) with TLHasCSR {
+  beatBytes: Int = 8,
+  burstBytes: Int = 64
+)(implicit p: Parameters) extends ReadQueue(depth, burstBytes = burstBytes) with TLHasCSR {
   val devname = "tlQueueOut"
   val devcompat = Seq("ucb-art", "dsptools")
   val device = new SimpleDevice(devname, devcompat) {
@@ -139,6 +193,9 @@ class TLReadQueue
   }
   // make diplomatic TL node for regmap
   override val mem = Some(TLRegisterNode(address = Seq(csrAddress), device = device, beatBytes = beatBytes))
+  // multi-beat bursts are split into consecutive single-beat register reads
+  val burstNode = TLFragmenter(beatBytes, burstBytes)
+  mem.get := burstNode
 
 }
 
@@ -161,6 +218,7 @@ abstract class CREECeleratorBlock[D, U, EO, EI, B <: Data, T]
   isWrite: Boolean = true
 )(implicit p: Parameters) extends DspBlock[D, U, EO, EI, B] with HasCSR {
   val streamNode = AXI4StreamIdentityNode()
+  val intnode = IntSourceNode(IntSourcePortSimple(num = 1))
 
   lazy val module = new LazyModuleImp(this) {
     require(streamNode.in.length == 1)
@@ -168,6 +226,12 @@ abstract class CREECeleratorBlock[D, U, EO, EI, B <: Data, T]
 
     val in = streamNode.in.head._1
     val out = streamNode.out.head._1
+    val (interrupt, _) = intnode.out(0)
+
+    // occupancy of the read queue fed by this block
+    val readQueueCount = IO(Input(UInt(32.W)))
+    // alternative header and data path driven by a CREECeleratorDMA
+    val dma = IO(Flipped(new CREECDMAIO))
 
     // TODO
     in.bits.last := false.B
@@ -183,6 +247,10 @@ abstract class CREECeleratorBlock[D, U, EO, EI, B <: Data, T]
     val crPadBytesIn = RegInit(0.U(32.W))
     val ePadBytesIn = RegInit(0.U(32.W))
     val eccPadBytesIn = RegInit(0.U(32.W))
+    // Sector address of the next MMIO transaction. It advances by one for
+    // every MMIO header accepted, so a run of consecutive sectors only needs
+    // it written once.
+    val addrIn = RegInit(0.U(32.W))
     // Out header info
     val numBeatsOut = RegInit(0.U(32.W))
     val crOut = RegInit(false.B)
@@ -191,6 +259,16 @@ abstract class CREECeleratorBlock[D, U, EO, EI, B <: Data, T]
     val crPadBytesOut = RegInit(0.U(32.W))
     val ePadBytesOut = RegInit(0.U(32.W))
     val eccPadBytesOut = RegInit(0.U(32.W))
+    // Interrupts
+    //   - bit 0: output header received (sticky, write 1 to clear)
+    //   - bit 1: read queue holds at least rqWatermark entries (level)
+    val intEnable = RegInit(0.U(2.W))
+    val hdrPending = RegInit(false.B)
+    val rqWatermark = RegInit(0.U(32.W))
+    val wmPending = (rqWatermark =/= 0.U) && (readQueueCount >= rqWatermark)
+    val intPending = Cat(wmPending, hdrPending)
+
+    interrupt(0) := (intPending & intEnable).orR
 
     val creec = if (isWrite) {
       Module(new CREECeleratorWrite())
@@ -203,13 +281,36 @@ abstract class CREECeleratorBlock[D, U, EO, EI, B <: Data, T]
     //   - sSendHeader: for sending the header to the creec
     //   - sSendData: for sending the data to the creec
     //   - sSendOut: for waiting until the CREEC computation finish and
-    //               sending the result to the StreamNode out
+    //               the rest of the result has been sent to the StreamNode out
+    // Output data is forwarded as soon as the output header has been seen,
+    // even while input beats are still being accepted in sSendData, so a
+    // transaction longer than the queues can stream through the pipeline.
     val sSendHeader :: sSendData :: sSendOut :: Nil = Enum(3)
     val state = RegInit(sSendHeader)
 
     val beatCnt = RegInit(0.U(32.W))
+    // Index of the last input beat, latched from whichever header (MMIO or
+    // DMA) started the transaction
+    val lastBeatIn = RegInit(0.U(32.W))
+    val outBeatCnt = RegInit(0.U(32.W))
+    // The header came from the DMA port instead of the MMIO registers, so
+    // data is taken from and returned to the DMA engine, not the queues.
+    // An MMIO start takes priority when both are pending.
+    val useDma = RegInit(false.B)
+    val startDma = !creecEnable && dma.header.valid
+    // outActive: output header received, data beats still to be forwarded
+    // outDone: every output beat of the current transaction has been sent
+    val outActive = RegInit(false.B)
+    val outDone = RegInit(false.B)
+
+    // No transaction pending, in flight or draining: nothing changes until
+    // the host or the DMA engine starts one
+    val idle = IO(Output(Bool()))
+    idle := state === sSendHeader && !creecEnable && !dma.header.valid && !outActive
 
     when (creec.io.out.header.fire()) {
+      outActive := true.B
+      outBeatCnt := 0.U
       numBeatsOut := creec.io.out.header.bits.len + 1.U
       crOut := creec.io.out.header.bits.compressed
       eOut := creec.io.out.header.bits.encrypted
@@ -219,34 +320,85 @@ abstract class CREECeleratorBlock[D, U, EO, EI, B <: Data, T]
       eccPadBytesOut := creec.io.out.header.bits.eccPadBytes
     }
 
-    creec.io.in.header.bits.len := numBeatsIn - 1.U
-    creec.io.in.header.valid := (state === sSendHeader) && creecEnable
+    creec.io.in.header.valid := (state === sSendHeader) &&
+                                (creecEnable || dma.header.valid)
+    dma.header.ready := (state === sSendHeader) && !creecEnable &&
+                        creec.io.in.header.ready
 
     // header beat
-    creec.io.in.header.bits.addr := 0.U
     creec.io.in.header.bits.id := 0.U
-    creec.io.in.header.bits.compressed := crIn
-    creec.io.in.header.bits.encrypted := eIn
-    creec.io.in.header.bits.ecc := eccIn
-    creec.io.in.header.bits.compressionPadBytes := crPadBytesIn
-    creec.io.in.header.bits.encryptionPadBytes := ePadBytesIn
-    creec.io.in.header.bits.eccPadBytes := eccPadBytesIn
+    when (startDma) {
+      creec.io.in.header.bits.addr := 0.U
+      creec.io.in.header.bits.len := dma.header.bits.len - 1.U
+      creec.io.in.header.bits.compressed := dma.header.bits.compressed
+      creec.io.in.header.bits.encrypted := dma.header.bits.encrypted
+      creec.io.in.header.bits.ecc := dma.header.bits.ecc
+      creec.io.in.header.bits.compressionPadBytes := dma.header.bits.compressionPadBytes
+      creec.io.in.header.bits.encryptionPadBytes := dma.header.bits.encryptionPadBytes
+      creec.io.in.header.bits.eccPadBytes := dma.header.bits.eccPadBytes
+    } .otherwise {
+      creec.io.in.header.bits.addr := addrIn
+      creec.io.in.header.bits.len := numBeatsIn - 1.U
+      creec.io.in.header.bits.compressed := crIn
+      creec.io.in.header.bits.encrypted := eIn
+      creec.io.in.header.bits.ecc := eccIn
+      creec.io.in.header.bits.compressionPadBytes := crPadBytesIn
+      creec.io.in.header.bits.encryptionPadBytes := ePadBytesIn
+      creec.io.in.header.bits.eccPadBytes := eccPadBytesIn
+    }
 
     // data beat
-    creec.io.in.data.bits.data := in.bits.data
+    creec.io.in.data.bits.data := Mux(useDma, dma.in.bits, in.bits.data)
     creec.io.in.data.bits.id := 0.U
 
-    creec.io.in.data.valid := (state === sSendData) && in.valid
+    creec.io.in.data.valid := (state === sSendData) &&
+                              Mux(useDma, dma.in.valid, in.valid)
 
-    // FIXME: being true all the time?
-    creec.io.out.header.ready := true.B
-    creec.io.out.data.ready := (state === sSendOut) && out.ready
+    // Only one transaction is in flight, so a new output header cannot
+    // arrive while the previous one is still being forwarded
+    creec.io.out.header.ready := !outActive
+    creec.io.out.data.ready := outActive && Mux(useDma, dma.out.ready, out.ready)
     out.bits.data := creec.io.out.data.bits.data
+    dma.out.bits := creec.io.out.data.bits.data
 
     // We need to take into account of the back-pressure from Streamnode in
     // and from Streamnode out as well
-    in.ready := (state === sSendData) && creec.io.in.data.ready
-    out.valid := (state === sSendOut) && creec.io.out.data.valid
+    in.ready := (state === sSendData) && !useDma && creec.io.in.data.ready
+    out.valid := outActive && !useDma && creec.io.out.data.valid
+    dma.in.ready := (state === sSendData) && useDma && creec.io.in.data.ready
+    dma.out.valid := outActive && useDma && creec.io.out.data.valid
+
+    dma.outHeader.valid := creec.io.out.header.fire() && useDma
+    dma.outHeader.bits.len := creec.io.out.header.bits.len + 1.U
+    dma.outHeader.bits.compressed := creec.io.out.header.bits.compressed
+    dma.outHeader.bits.encrypted := creec.io.out.header.bits.encrypted
+    dma.outHeader.bits.ecc := creec.io.out.header.bits.ecc
+    dma.outHeader.bits.compressionPadBytes := creec.io.out.header.bits.compressionPadBytes
+    dma.outHeader.bits.encryptionPadBytes := creec.io.out.header.bits.encryptionPadBytes
+    dma.outHeader.bits.eccPadBytes := creec.io.out.header.bits.eccPadBytes
+
+    // creecEnable is a one-shot start bit: drop it once the header has been
+    // accepted so the next transaction waits for a fresh header from the host
+    when (creec.io.in.header.fire()) {
+      creecEnable := false.B
+      outDone := false.B
+      useDma := startDma
+      lastBeatIn := creec.io.in.header.bits.len
+      when (!startDma) {
+        addrIn := addrIn + 1.U
+      }
+    }
+
+    when (creec.io.out.data.fire()) {
+      when (outBeatCnt === numBeatsOut - 1.U) {
+        outActive := false.B
+        outDone := true.B
+        outBeatCnt := 0.U
+      }
+      .otherwise {
+        outBeatCnt := outBeatCnt + 1.U
+      }
+    }
 
     switch (state) {
       is (sSendHeader) {
@@ -257,7 +409,7 @@ abstract class CREECeleratorBlock[D, U, EO, EI, B <: Data, T]
 
       is (sSendData) {
         when (creec.io.in.data.fire()) {
-          when (beatCnt === numBeatsIn - 1.U) {
+          when (beatCnt === lastBeatIn) {
             state := sSendOut
             beatCnt := 0.U
           }
@@ -268,23 +420,25 @@ abstract class CREECeleratorBlock[D, U, EO, EI, B <: Data, T]
       }
 
       is (sSendOut) {
-        when (creec.io.out.data.fire()) {
-          when (beatCnt === numBeatsOut - 1.U) {
-            state := sSendHeader
-            beatCnt := 0.U
-          }
-          .otherwise {
-            beatCnt := beatCnt + 1.U
-          }
+        when (outDone) {
+          state := sSendHeader
         }
       }
     }
 
-    // We ignore addr and id fields as of now
-    // since they are not relevant to what we
+    // We ignore the id field as of now
+    // since it is not relevant to what we
     // want to test
     regmap(
-      0x00 -> Seq(RegField.w(1,  creecEnable)),
+      // Starting a transaction also clears numBeatsOut, so it only becomes
+      // non-zero again once the output header of the new transaction arrives
+      0x00 -> Seq(RegField.w(1, RegWriteFn((valid, data) => {
+        when (valid) {
+          creecEnable := data(0)
+          numBeatsOut := 0.U
+        }
+        true.B
+      }))),
       0x04 -> Seq(RegField.w(32, numBeatsIn)),
       0x08 -> Seq(RegField.w(1,  crIn)),
       0x0c -> Seq(RegField.w(1,  eIn)),
@@ -298,9 +452,46 @@ abstract class CREECeleratorBlock[D, U, EO, EI, B <: Data, T]
       0x2c -> Seq(RegField.r(1,  eccOut)),
       0x30 -> Seq(RegField.r(32, crPadBytesOut)),
       0x34 -> Seq(RegField.r(32, ePadBytesOut)),
-      0x38 -> Seq(RegField.r(32, eccPadBytesOut))
+      0x38 -> Seq(RegField.r(32, eccPadBytesOut)),
+      0x3c -> Seq(RegField(2, intEnable)),
+      0x40 -> Seq(RegField(2, intPending, RegWriteFn((valid, data) => {
+        when (valid && data(0)) {
+          hdrPending := false.B
+        }
+        true.B
+      }))),
+      0x44 -> Seq(RegField(32, rqWatermark)),
+      // Packed header, one 64-bit access instead of seven 32-bit ones:
+      //   [31:0] len, [32] compressed, [33] encrypted, [34] ecc,
+      //   [35] start (in only), [47:40] compression pad bytes,
+      //   [55:48] encryption pad bytes, [63:56] ecc pad bytes
+      0x48 -> Seq(RegField.w(64, RegWriteFn((valid, data) => {
+        when (valid) {
+          numBeatsIn := data(31, 0)
+          crIn := data(32)
+          eIn := data(33)
+          eccIn := data(34)
+          crPadBytesIn := data(47, 40)
+          ePadBytesIn := data(55, 48)
+          eccPadBytesIn := data(63, 56)
+          when (data(35)) {
+            creecEnable := true.B
+            numBeatsOut := 0.U
+          }
+        }
+        true.B
+      }))),
+      0x50 -> Seq(RegField.r(64, Cat(eccPadBytesOut(7, 0), ePadBytesOut(7, 0),
+                                     crPadBytesOut(7, 0), 0.U(5.W),
+                                     eccOut, eOut, crOut, numBeatsOut))),
+      0x58 -> Seq(RegField(32, addrIn))
     )
 
+    // placed after the regmap so a new header wins over a simultaneous clear
+    when (creec.io.out.header.fire()) {
+      hdrPending := true.B
+    }
+
   }
 }
 
@@ -366,12 +557,31 @@ class CREECeleratorThing[T]
   val creecR = LazyModule(new TLCREECeleratorBlock(
                  isWrite = false, csrAddress = AddressSet(0x2500, 0xff)))
 
+  val dmaW = LazyModule(new CREECeleratorDMA(
+               csrAddress = AddressSet(0x2600, 0xff), name = "creecDMAW"))
+  val dmaR = LazyModule(new CREECeleratorDMA(
+               csrAddress = AddressSet(0x2700, 0xff), name = "creecDMAR"))
+
   // connect streamNodes of queues and creecelerators
   // separate {read, write} queues for creecR and creecW
   readQueueW.streamNode := creecW.streamNode := writeQueueW.streamNode
   readQueueR.streamNode := creecR.streamNode := writeQueueR.streamNode
 
-  lazy val module = new LazyModuleImp(this)
+  lazy val module = new LazyModuleImp(this) {
+    // read queue occupancy drives each block's watermark interrupt
+    creecW.module.readQueueCount := readQueueW.module.queueCount
+    creecR.module.readQueueCount := readQueueR.module.queueCount
+
+    creecW.module.dma <> dmaW.module.pipe
+    creecR.module.dma <> dmaR.module.pipe
+
+    // Both pipelines and DMA engines are idle. Read by the emulator, which
+    // fast-forwards over cycles in which nothing can happen (--fast-forward).
+    val idle = IO(Output(Bool()))
+    idle := creecW.module.idle && creecR.module.idle &&
+            dmaW.module.idle && dmaR.module.idle
+    dontTouch(idle)
+  }
 }
 
 /**
@@ -384,22 +594,37 @@ trait HasPeripheryCREECelerator extends BaseSubsystem {
 
   // connect memory interfaces to pbus
   pbus.toVariableWidthSlave(Some("writeQueueW")) {
-    creecChain.writeQueueW.mem.get
+    creecChain.writeQueueW.burstNode
   }
   pbus.toVariableWidthSlave(Some("readQueueW")) {
-    creecChain.readQueueW.mem.get
+    creecChain.readQueueW.burstNode
   }
   pbus.toVariableWidthSlave(Some("creecW")) {
     creecChain.creecW.mem.get
   }
   pbus.toVariableWidthSlave(Some("writeQueueR")) {
-    creecChain.writeQueueR.mem.get
+    creecChain.writeQueueR.burstNode
   }
   pbus.toVariableWidthSlave(Some("readQueueR")) {
-    creecChain.readQueueR.mem.get
+    creecChain.readQueueR.burstNode
   }
   pbus.toVariableWidthSlave(Some("creecR")) {
     creecChain.creecR.mem.get
   }
+
+  pbus.toVariableWidthSlave(Some("creecDMAW")) {
+    creecChain.dmaW.mem.get
+  }
+  pbus.toVariableWidthSlave(Some("creecDMAR")) {
+    creecChain.dmaR.mem.get
+  }
+
+  // the DMA engines master memory through the front bus
+  fbus.fromPort(Some("creecDMAW"))() := creecChain.dmaW.node
+  fbus.fromPort(Some("creecDMAR"))() := creecChain.dmaR.node
+
+  // completion and watermark interrupts go to the PLIC
+  ibus.fromSync := creecChain.creecW.intnode
+  ibus.fromSync := creecChain.creecR.intnode
 }
 
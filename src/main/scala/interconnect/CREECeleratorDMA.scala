@@ -0,0 +1,330 @@
+package interconnect
+
+import chisel3._
+import chisel3.util._
+import dspblocks._
+import freechips.rocketchip.config.Parameters
+import freechips.rocketchip.diplomacy._
+import freechips.rocketchip.regmapper._
+import freechips.rocketchip.tilelink._
+
+/**
+  * Transaction header as seen by the DMA engine. The packing of toWord
+  * matches word 2 of a descriptor and word 0 of a completion record:
+  *   [31:0] len (beats), [32] compressed, [33] encrypted, [34] ecc,
+  *   [47:40] compression pad bytes, [55:48] encryption pad bytes,
+  *   [63:56] ecc pad bytes
+  */
+class CREECDMAHeader extends Bundle {
+  val len = UInt(32.W)
+  val compressed = Bool()
+  val encrypted = Bool()
+  val ecc = Bool()
+  val compressionPadBytes = UInt(8.W)
+  val encryptionPadBytes = UInt(8.W)
+  val eccPadBytes = UInt(8.W)
+
+  def fromWord(w: UInt): Unit = {
+    len := w(31, 0)
+    compressed := w(32)
+    encrypted := w(33)
+    ecc := w(34)
+    compressionPadBytes := w(47, 40)
+    encryptionPadBytes := w(55, 48)
+    eccPadBytes := w(63, 56)
+  }
+
+  def toWord: UInt = Cat(eccPadBytes, encryptionPadBytes, compressionPadBytes,
+                         0.U(5.W), ecc, encrypted, compressed, len)
+}
+
+/**
+  * Connection between a CREECeleratorDMA and the CREECeleratorBlock it feeds,
+  * from the point of view of the DMA engine
+  */
+class CREECDMAIO extends Bundle {
+  val header = Decoupled(new CREECDMAHeader)
+  val in = Decoupled(UInt(64.W))
+  val out = Flipped(Decoupled(UInt(64.W)))
+  val outHeader = Flipped(Valid(new CREECDMAHeader))
+}
+
+/**
+  * Descriptor-ring DMA engine for one CREEC pipeline.
+  *
+  * Software fills 32-byte descriptors in a ring at ringBase and advances head.
+  * For every descriptor between tail and head the engine fetches the
+  * descriptor, hands its header to the block, streams len beats from src into
+  * the pipeline while writing the output beats to dst, and finally writes a
+  * 16-byte completion record to compBase before advancing tail.
+  *
+  * Descriptor layout (little endian 64-bit words):
+  *   0: src address (8-byte aligned)
+  *   1: dst address (8-byte aligned)
+  *   2: header, packed as in CREECDMAHeader (len must be non-zero)
+  *   3: [31:0] capacity of dst in beats
+  * Completion record:
+  *   0: output header, packed as in CREECDMAHeader
+  *   1: [0] done, [1] output truncated to the dst capacity,
+  *      [63:32] value of tail when the descriptor was processed
+  *
+  * @param csrAddress address range of the control registers
+  * @param beatBytes beatBytes of the control register TL interface
+  * @param name name of the TL client
+  * @param p
+  */
+class CREECeleratorDMA
+(
+  csrAddress: AddressSet = AddressSet(0x2600, 0xff),
+  beatBytes: Int = 8,
+  name: String = "creecDMA"
+)(implicit p: Parameters) extends LazyModule with HasCSR with TLHasCSR {
+  val devname = name
+  val devcompat = Seq("ucb-art", "dsptools")
+  val device = new SimpleDevice(devname, devcompat) {
+    override def describe(resources: ResourceBindings): Description = {
+      val Description(name, mapping) = super.describe(resources)
+      Description(name, mapping)
+    }
+  }
+  // make diplomatic TL node for regmap
+  override val mem = Some(TLRegisterNode(address = Seq(csrAddress), device = device, beatBytes = beatBytes))
+
+  // source 0: descriptor and input reads, source 1: output and completion writes
+  val node = TLClientNode(Seq(TLClientPortParameters(
+    Seq(TLClientParameters(name = name, sourceId = IdRange(0, 2))))))
+
+  lazy val module = new LazyModuleImp(this) {
+    val (tl, edge) = node.out(0)
+    val pipe = IO(new CREECDMAIO)
+
+    require(edge.manager.beatBytes == 8,
+            "CREEC DMA moves one 64-bit pipeline beat per TileLink beat")
+
+    val descBytes = 32
+    val compBytes = 16
+    // Longest burst, in beats, and depth of the staging queues
+    val maxBurst = 8
+    val stageDepth = 2 * maxBurst
+
+    // MMIO Registers
+    val enable = RegInit(false.B)
+    val ringBase = RegInit(0.U(64.W))
+    val compBase = RegInit(0.U(64.W))
+    val ringMask = RegInit(0.U(32.W))
+    val head = RegInit(0.U(32.W))
+    val tail = RegInit(0.U(32.W))
+
+    // Current descriptor
+    val src = Reg(UInt(64.W))
+    val dst = Reg(UInt(64.W))
+    val header = Reg(new CREECDMAHeader)
+    val dstBeats = Reg(UInt(32.W))
+
+    // Output header, valid once outKnown is set
+    val outHeader = Reg(new CREECDMAHeader)
+    val outKnown = RegInit(false.B)
+    val overflow = RegInit(false.B)
+
+    // Progress, in beats
+    val inRequested = RegInit(0.U(32.W))
+    val outReceived = RegInit(0.U(32.W))
+    val outWritten = RegInit(0.U(32.W))
+    val readBusy = RegInit(false.B)
+    val writeBusy = RegInit(false.B)
+    val putBeatsLeft = RegInit(0.U(4.W))
+    val putAddr = Reg(UInt(64.W))
+    val putLgSize = Reg(UInt(3.W))
+
+    val inQueue = Module(new Queue(UInt(64.W), stageDepth))
+    val outQueue = Module(new Queue(UInt(64.W), stageDepth))
+
+    // There are seven states:
+    //   - sIdle: waiting for head to move past tail
+    //   - sFetch/sFetchWait: reading the descriptor at tail
+    //   - sHeader: handing the header to the block
+    //   - sRun: moving data between memory and the pipeline
+    //   - sComplete/sCompleteWait: writing the completion record
+    val sIdle :: sFetch :: sFetchWait :: sHeader :: sRun :: sComplete :: sCompleteWait :: Nil = Enum(7)
+    val state = RegInit(sIdle)
+
+    // Nothing to fetch or move until head is written
+    val idle = IO(Output(Bool()))
+    idle := state === sIdle && !(enable && head =/= tail)
+
+    val slot = tail & ringMask
+    val descAddr = ringBase + (slot << log2Ceil(descBytes))
+    val compAddr = compBase + (slot << log2Ceil(compBytes))
+
+    // log2 of the largest naturally aligned burst of at most maxBurst beats
+    // starting at addr and not running past the end of the transfer
+    def burstLg(addr: UInt, beats: UInt): UInt = {
+      Mux(addr(5, 0) === 0.U && beats >= 8.U, 3.U,
+      Mux(addr(4, 0) === 0.U && beats >= 4.U, 2.U,
+      Mux(addr(3, 0) === 0.U && beats >= 2.U, 1.U, 0.U)))
+    }
+
+    def addr(a: UInt): UInt = a(edge.bundle.addressBits - 1, 0)
+
+    // Input side: reads from src into inQueue
+    val inLeft = header.len - inRequested
+    val inAddr = src + (inRequested << 3)
+    val inLg = burstLg(inAddr, inLeft)
+    val canRead = state === sRun && !readBusy && inLeft =/= 0.U &&
+                  inQueue.io.count <= (stageDepth - maxBurst).U
+
+    // Output side: writes from outQueue to dst
+    val outWritable = Mux(outHeader.len > dstBeats, dstBeats, outHeader.len)
+    val outLeft = outWritable - outWritten
+    val outAddr = dst + (outWritten << 3)
+    val outLg = burstLg(outAddr, outLeft)
+    val canWrite = state === sRun && outKnown && !writeBusy &&
+                   putBeatsLeft === 0.U && outLeft =/= 0.U &&
+                   outQueue.io.count >= (1.U << outLg)
+
+    val (_, descGet) = edge.Get(0.U, addr(descAddr), log2Ceil(descBytes).U)
+    val (_, dataGet) = edge.Get(0.U, addr(inAddr), inLg +& 3.U)
+    val (_, dataPut) = edge.Put(1.U, addr(putAddr), putLgSize +& 3.U, outQueue.io.deq.bits)
+    val compBeat = RegInit(0.U(1.W))
+    val compData = Mux(compBeat === 0.U, outHeader.toWord,
+                       Cat(tail, 0.U(30.W), overflow, true.B))
+    val (_, compPut) = edge.Put(1.U, addr(compAddr), log2Ceil(compBytes).U, compData)
+
+    val putting = putBeatsLeft =/= 0.U
+
+    // A channel: a multi-beat Put owns the channel until its last beat
+    tl.a.valid := false.B
+    tl.a.bits := descGet
+    outQueue.io.deq.ready := false.B
+    when (state === sFetch) {
+      tl.a.valid := true.B
+    } .elsewhen (state === sComplete) {
+      tl.a.valid := true.B
+      tl.a.bits := compPut
+    } .elsewhen (putting) {
+      tl.a.valid := outQueue.io.deq.valid
+      tl.a.bits := dataPut
+      outQueue.io.deq.ready := tl.a.ready
+    } .elsewhen (canRead) {
+      tl.a.valid := true.B
+      tl.a.bits := dataGet
+    }
+
+    when (tl.a.fire()) {
+      when (state === sFetch) {
+        state := sFetchWait
+      } .elsewhen (state === sComplete) {
+        compBeat := compBeat + 1.U
+        when (compBeat === 1.U) {
+          state := sCompleteWait
+        }
+      } .elsewhen (putting) {
+        putBeatsLeft := putBeatsLeft - 1.U
+      } .otherwise {
+        readBusy := true.B
+        inRequested := inRequested + (1.U << inLg)
+      }
+    }
+
+    // Start the next output burst once enough beats are staged
+    when (canWrite) {
+      writeBusy := true.B
+      putAddr := outAddr
+      putLgSize := outLg
+      putBeatsLeft := 1.U << outLg
+      outWritten := outWritten + (1.U << outLg)
+    }
+
+    // D channel
+    val (_, dLast, _, dCount) = edge.count(tl.d)
+    val dIsRead = tl.d.bits.source === 0.U
+    inQueue.io.enq.valid := tl.d.valid && dIsRead && state === sRun
+    inQueue.io.enq.bits := tl.d.bits.data
+    tl.d.ready := !(dIsRead && state === sRun) || inQueue.io.enq.ready
+
+    when (tl.d.fire()) {
+      when (state === sFetchWait) {
+        switch (dCount) {
+          is (0.U) { src := tl.d.bits.data }
+          is (1.U) { dst := tl.d.bits.data }
+          is (2.U) { header.fromWord(tl.d.bits.data) }
+          is (3.U) { dstBeats := tl.d.bits.data(31, 0) }
+        }
+        when (dLast) {
+          state := sHeader
+        }
+      } .elsewhen (state === sCompleteWait) {
+        tail := tail + 1.U
+        state := sIdle
+      } .elsewhen (dIsRead) {
+        when (dLast) {
+          readBusy := false.B
+        }
+      } .otherwise {
+        writeBusy := false.B
+      }
+    }
+
+    // Pipeline side
+    pipe.header.valid := state === sHeader
+    pipe.header.bits := header
+    pipe.in <> inQueue.io.deq
+
+    // Beats beyond the dst capacity are dropped
+    outQueue.io.enq.valid := pipe.out.valid && outReceived < dstBeats
+    outQueue.io.enq.bits := pipe.out.bits
+    pipe.out.ready := outQueue.io.enq.ready || outReceived >= dstBeats
+    when (pipe.out.fire()) {
+      outReceived := outReceived + 1.U
+    }
+
+    when (pipe.outHeader.valid) {
+      outHeader := pipe.outHeader.bits
+      outKnown := true.B
+      overflow := pipe.outHeader.bits.len > dstBeats
+    }
+
+    switch (state) {
+      is (sIdle) {
+        when (enable && head =/= tail) {
+          state := sFetch
+        }
+      }
+
+      is (sHeader) {
+        when (pipe.header.fire()) {
+          state := sRun
+          inRequested := 0.U
+          outReceived := 0.U
+          outWritten := 0.U
+          outKnown := false.B
+          overflow := false.B
+        }
+      }
+
+      is (sRun) {
+        when (outKnown && outReceived === outHeader.len && outLeft === 0.U &&
+              inLeft === 0.U && !readBusy && !writeBusy && !putting &&
+              !inQueue.io.deq.valid) {
+          state := sComplete
+          compBeat := 0.U
+        }
+      }
+    }
+
+    // Unused channels
+    tl.b.ready := true.B
+    tl.c.valid := false.B
+    tl.e.valid := false.B
+
+    regmap(
+      0x00 -> Seq(RegField(1,  enable)),
+      0x08 -> Seq(RegField(64, ringBase)),
+      0x10 -> Seq(RegField(64, compBase)),
+      0x18 -> Seq(RegField(32, ringMask)),
+      0x1c -> Seq(RegField(32, head)),
+      0x20 -> Seq(RegField.r(32, tail)),
+      0x24 -> Seq(RegField.r(1,  state =/= sIdle))
+    )
+  }
+}
@@ -1,11 +1,13 @@
 package interconnect
 
 import chisel3._
+import chisel3.core.dontTouch
 import chisel3.util._
 import dspblocks._
 import freechips.rocketchip.amba.axi4stream._
 import freechips.rocketchip.config.Parameters
 import freechips.rocketchip.diplomacy._
+import freechips.rocketchip.interrupts._
 import freechips.rocketchip.regmapper._
 import freechips.rocketchip.tilelink._
 import freechips.rocketchip.subsystem.BaseSubsystem
@@ -29,6 +31,7 @@ abstract class CREECeleratorReadBlock[D, U, EO, EI, B <: Data, T]
 (
 )(implicit p: Parameters) extends DspBlock[D, U, EO, EI, B] with HasCSR {
   val streamNode = AXI4StreamIdentityNode()
+  val intnode = IntSourceNode(IntSourcePortSimple(num = 1))
 
   lazy val module = new LazyModuleImp(this) {
     require(streamNode.in.length == 1)
@@ -36,6 +39,7 @@ abstract class CREECeleratorReadBlock[D, U, EO, EI, B <: Data, T]
 
     val in = streamNode.in.head._1
     val out = streamNode.out.head._1
+    val (interrupt, _) = intnode.out(0)
 
     // TODO
     in.bits.last := false.B
@@ -53,6 +57,11 @@ abstract class CREECeleratorReadBlock[D, U, EO, EI, B <: Data, T]
     val crPadBytesIn = RegInit(0.U(32.W))
     val ePadBytesIn = RegInit(0.U(32.W))
     val eccPadBytesIn = RegInit(0.U(32.W))
+    // Interrupt when the output header is received (sticky, write 1 to clear)
+    val intEnable = RegInit(false.B)
+    val hdrPending = RegInit(false.B)
+
+    interrupt(0) := intEnable && hdrPending
 
     val creecR = Module(new CREECeleratorRead())
     val busParams = creecR.io.in.p
@@ -67,6 +76,10 @@ abstract class CREECeleratorReadBlock[D, U, EO, EI, B <: Data, T]
     val sSendHeader :: sSendData :: sSendOut :: Nil = Enum(3)
     val state = RegInit(sSendHeader)
 
+    // No transaction started or in flight
+    val idle = IO(Output(Bool()))
+    idle := state === sSendHeader && !enable
+
     val beatCnt = RegInit(0.U(32.W))
 
     //Most of this is bypassed below
@@ -168,8 +181,20 @@ abstract class CREECeleratorReadBlock[D, U, EO, EI, B <: Data, T]
       0x18 -> Seq(RegField.w(32, crPadBytesIn)),
       0x1c -> Seq(RegField.w(32, ePadBytesIn)),
       0x20 -> Seq(RegField.w(32, eccPadBytesIn)),
+      0x24 -> Seq(RegField(1, intEnable)),
+      0x28 -> Seq(RegField(1, hdrPending, RegWriteFn((valid, data) => {
+        when (valid && data(0)) {
+          hdrPending := false.B
+        }
+        true.B
+      }))),
     )
 
+    // placed after the regmap so a new header wins over a simultaneous clear
+    when (creecR.io.out.header.fire()) {
+      hdrPending := true.B
+    }
+
   }
 }
 
@@ -227,7 +252,12 @@ class CREECeleratorReadThing[T]
   // connect streamNodes of queues and creec
   readQueue.streamNode := creec.streamNode := writeQueue.streamNode
 
-  lazy val module = new LazyModuleImp(this)
+  lazy val module = new LazyModuleImp(this) {
+    // Read by the emulator's --fast-forward
+    val idle = IO(Output(Bool()))
+    idle := creec.module.idle
+    dontTouch(idle)
+  }
 }
 
 /**
@@ -239,8 +269,10 @@ trait HasPeripheryCREECeleratorRead extends BaseSubsystem {
   val creecChain = LazyModule(new CREECeleratorReadThing())
 
   // connect memory interfaces to pbus
-  pbus.toVariableWidthSlave(Some("writeQueue")) { creecChain.writeQueue.mem.get }
-  pbus.toVariableWidthSlave(Some("readQueue")) { creecChain.readQueue.mem.get }
+  pbus.toVariableWidthSlave(Some("writeQueue")) { creecChain.writeQueue.burstNode }
+  pbus.toVariableWidthSlave(Some("readQueue")) { creecChain.readQueue.burstNode }
   pbus.toVariableWidthSlave(Some("creecR")) { creecChain.creec.mem.get }
 
+  ibus.fromSync := creecChain.creec.intnode
+
 }
\ No newline at end of file
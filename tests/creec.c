@@ -1,45 +1,6 @@
-#define BYTE_WIDTH 8
-#define BYTES_PER_BEAT 8
-#define BEAT_WIDTH (BYTES_PER_BEAT * BYTE_WIDTH)
 #include <stdio.h>
 
-#include "creec_configs.h"
-#include "mmio.h"
-
-void header_write(uint32_t BASE_ADDR,
-                  uint32_t len,
-                  uint32_t compressed, uint32_t encrypted, uint32_t ecc,
-                  uint32_t compressed_pad_bytes,
-                  uint32_t encrypted_pad_bytes,
-                  uint32_t ecc_pad_bytes) {
-  reg_write32(BASE_ADDR + NUM_BEATS_IN_OFFSET, len);
-  reg_write32(BASE_ADDR + CR_IN_OFFSET, compressed);
-  reg_write32(BASE_ADDR + E_IN_OFFSET, encrypted);
-  reg_write32(BASE_ADDR + ECC_IN_OFFSET, ecc);
-  reg_write32(BASE_ADDR + CR_PADBYTES_IN_OFFSET, compressed_pad_bytes);
-  reg_write32(BASE_ADDR + E_PADBYTES_IN_OFFSET, encrypted_pad_bytes);
-  reg_write32(BASE_ADDR + ECC_PADBYTES_IN_OFFSET, ecc_pad_bytes);
-}
-
-void header_read(uint32_t BASE_ADDR, uint32_t *header) {
-  header[0] = reg_read32(BASE_ADDR + NUM_BEATS_OUT_OFFSET);
-  header[1] = reg_read32(BASE_ADDR + CR_OUT_OFFSET);
-  header[2] = reg_read32(BASE_ADDR + E_OUT_OFFSET);
-  header[3] = reg_read32(BASE_ADDR + ECC_OUT_OFFSET);
-  header[4] = reg_read32(BASE_ADDR + CR_PADBYTES_OUT_OFFSET);
-  header[5] = reg_read32(BASE_ADDR + E_PADBYTES_OUT_OFFSET);
-  header[6] = reg_read32(BASE_ADDR + ECC_PADBYTES_OUT_OFFSET);
-}
-
-uint64_t pack_data(uint8_t *input, int i) {
-  int j;
-  uint64_t result = 0;
-  for (j = i * BYTES_PER_BEAT; j < (i + 1) * BYTES_PER_BEAT; j++) {
-    result = (result >> BYTES_PER_BEAT) |
-		         ((uint64_t)input[j] << (BEAT_WIDTH - BYTE_WIDTH));
-  }
-  return result;
-}
+#include "libcreec.h"
 
 int main(void)
 {
@@ -72,34 +33,39 @@ int main(void)
   int i, j;
   uint32_t len = sizeof(data) / BYTES_PER_BEAT;
 
-  header_write(CREECW_ENABLE, len, 0, 0, 0, 0, 0, 0);
-  reg_write32(CREECW_ENABLE, 1);
-
-  for (i = 0; i < len; i++) {
-    uint64_t packed_data = pack_data(data, i);
-    printf("Sending data %lu\n", packed_data);
-    reg_write64(WRITEQ_W, packed_data);
-  }
+  int8_t data_outW[10 * BYTES_PER_BEAT];
 
-  uint16_t counter = 0;
-  while (reg_read32(CREECW_ENABLE + NUM_BEATS_OUT_OFFSET) == 0) {
-    counter += 1;
-//    if (i % 10 == 0) {
-//        printf("counter %d\n", counter);
-//    }
-  }
-  printf("finished at counter %d\n", counter);
+  creec_dev_t creecW;
+  creec_init_write(&creecW);
+  creec_irq_init(&creecW, CREECW_IRQ);
+
+  // Gather the input from fragments that split beats at odd offsets
+  creec_iovec_t data_iov[] = {
+    { data, 5 },
+    { data + 5, 19 },
+    { data + 24, sizeof(data) - 24 },
+  };
+
+  creec_req_t reqW = {
+    .header_in = { .len = len },
+    .src_iov = data_iov,
+    .src_iovcnt = 3,
+    .dst = (uint8_t *)data_outW,
+    .dst_bytes = sizeof(data_outW),
+  };
+  creec_submit(&creecW, &reqW);
+  creec_wait_irq(&creecW, &reqW);
 
   // Receive the CREECBus transaction header from creecW
-  uint32_t headerW[7];
-  header_read(CREECW_ENABLE, headerW);
-  uint32_t lenW                  = headerW[0];
-  uint32_t compressedW           = headerW[1];
-  uint32_t encryptedW            = headerW[2];
-  uint32_t eccW                  = headerW[3];
-  uint32_t compressed_pad_bytesW = headerW[4];
-  uint32_t encrypted_pad_bytesW  = headerW[5];
-  uint32_t ecc_pad_bytesW        = headerW[6];
+  uint32_t lenW                  = reqW.header_out.len;
+  uint32_t compressedW           = reqW.header_out.compressed;
+  uint32_t encryptedW            = reqW.header_out.encrypted;
+  uint32_t eccW                  = reqW.header_out.ecc;
+  uint32_t compressed_pad_bytesW = reqW.header_out.compressed_pad_bytes;
+  uint32_t encrypted_pad_bytesW  = reqW.header_out.encrypted_pad_bytes;
+  uint32_t ecc_pad_bytesW        = reqW.header_out.ecc_pad_bytes;
+
+  printf("creecW interrupts: %d\n", creecW.irq_count);
 
   printf("Received header: %d %d %d %d %d %d %d\n",
     lenW, compressedW, encryptedW, eccW,
@@ -111,14 +77,9 @@ int main(void)
 
   int numErrorsW = 0;
 
-  int8_t data_outW[10 * BYTES_PER_BEAT];
-
-  for (i = 0; i < lenW; i++) { 
-    uint64_t output = reg_read64(READQ_W);
+  for (i = 0; i < lenW; i++) {
     for (j = 0; j < BYTES_PER_BEAT; j++) {
-      int8_t out_data = output & 0xFF;
-      data_outW[i * BYTES_PER_BEAT + j] = out_data;
-      output = output >> BYTES_PER_BEAT;
+      int8_t out_data = data_outW[i * BYTES_PER_BEAT + j];
       printf("OUT: (i=%d, j=%d) creecW=%d, gold=%d\n",
              i, j, out_data, gold_data[i * BYTES_PER_BEAT +j]);
       if (out_data != gold_data[i * BYTES_PER_BEAT + j]) {
@@ -134,79 +95,48 @@ int main(void)
     printf("creecW FAILED with %d mismatches!\n", numErrorsW);
   }
 
-    // Make some noise to test ECC capability
-  data_outW[16 * 0 + 0] = 0;
-  data_outW[16 * 0 + 1] = 1;
-  data_outW[16 * 0 + 2] = 2;
-  data_outW[16 * 0 + 3] = 3;
-
-  data_outW[16 * 1 + 0] = 0;
-  data_outW[16 * 1 + 1] = 1;
-  data_outW[16 * 1 + 2] = 2;
-  data_outW[16 * 1 + 3] = 3;
-
-  data_outW[16 * 2 + 0] = 0;
-  data_outW[16 * 2 + 1] = 1;
-  data_outW[16 * 2 + 2] = 2;
-  data_outW[16 * 2 + 3] = 3;
-
-  data_outW[16 * 3 + 0] = 0;
-  data_outW[16 * 3 + 1] = 1;
-  data_outW[16 * 3 + 2] = 2;
-  data_outW[16 * 3 + 3] = 3;
-
-  data_outW[16 * 4 + 0] = 0;
-  data_outW[16 * 4 + 1] = 1;
-  data_outW[16 * 4 + 2] = 2;
-  data_outW[16 * 4 + 3] = 3;
-
-  data_outW[16 * 5 + 0] = 0;
-  data_outW[16 * 5 + 1] = 1;
-  data_outW[16 * 5 + 2] = 2;
-  data_outW[16 * 5 + 3] = 3;
-
-  data_outW[16 * 6 + 0] = 0;
-  data_outW[16 * 6 + 1] = 1;
-  data_outW[16 * 6 + 2] = 2;
-  data_outW[16 * 6 + 3] = 3;
-
-  data_outW[16 * 7 + 0] = 0;
-  data_outW[16 * 7 + 1] = 1;
-  data_outW[16 * 7 + 2] = 2;
-  data_outW[16 * 7 + 3] = 3;
-
-  header_write(CREECR_ENABLE, lenW,
-               compressedW, encryptedW, eccW,
-               compressed_pad_bytesW,
-               encrypted_pad_bytesW,
-               ecc_pad_bytesW);
-  reg_write32(CREECR_ENABLE, 1);
-
-  for (i = 0; i < lenW; i++) {
-    uint64_t packed_data = pack_data(data_outW, i);
-    printf("Sending data %lu\n", packed_data);
-    reg_write64(WRITEQ_R, packed_data);
+  // Make some noise to test ECC capability: corrupt the first four bytes of
+  // every 16-byte block of the encoded output, and nothing past its end
+  uint32_t noise_bytes = lenW * BYTES_PER_BEAT;
+  if (noise_bytes > sizeof(data_outW))
+    noise_bytes = sizeof(data_outW);
+  for (i = 0; i + 4 <= noise_bytes; i += 16) {
+    for (j = 0; j < 4; j++)
+      data_outW[i + j] = j;
   }
 
-  counter = 0;
-  while (reg_read32(CREECR_ENABLE + NUM_BEATS_OUT_OFFSET) == 0) {
-    counter += 1;
-//    if (i % 10 == 0) {
-//        printf("counter %d\n", counter);
-//    }
-  }
-  printf("finished at counter %d\n", counter);
+  int8_t data_outR[10 * BYTES_PER_BEAT];
+
+  creec_dev_t creecR;
+  creec_init_read(&creecR);
+  creec_irq_init(&creecR, CREECR_IRQ);
+
+  // Feed the write path output header back so the read path knows how
+  // to undo each stage
+  // Scatter the output, starting the second fragment mid-beat
+  creec_iovec_t data_outR_iov[] = {
+    { data_outR, 13 },
+    { data_outR + 13, sizeof(data_outR) - 13 },
+  };
+
+  creec_req_t reqR = {
+    .header_in = reqW.header_out,
+    .src = (uint8_t *)data_outW,
+    .dst_iov = data_outR_iov,
+    .dst_iovcnt = 2,
+    .flags = CREEC_F_STREAM,
+  };
+  creec_submit(&creecR, &reqR);
+  creec_wait_irq(&creecR, &reqR);
 
   // Receive the CREECBus transaction header from creecR
-  uint32_t headerR[7];
-  header_read(CREECR_ENABLE, headerR);
-  uint32_t lenR                  = headerR[0];
-  uint32_t compressedR           = headerR[1];
-  uint32_t encryptedR            = headerR[2];
-  uint32_t eccR                  = headerR[3];
-  uint32_t compressed_pad_bytesR = headerR[4];
-  uint32_t encrypted_pad_bytesR  = headerR[5];
-  uint32_t ecc_pad_bytesR        = headerR[6];
+  uint32_t lenR                  = reqR.header_out.len;
+  uint32_t compressedR           = reqR.header_out.compressed;
+  uint32_t encryptedR            = reqR.header_out.encrypted;
+  uint32_t eccR                  = reqR.header_out.ecc;
+  uint32_t compressed_pad_bytesR = reqR.header_out.compressed_pad_bytes;
+  uint32_t encrypted_pad_bytesR  = reqR.header_out.encrypted_pad_bytes;
+  uint32_t ecc_pad_bytesR        = reqR.header_out.ecc_pad_bytes;
 
   printf("Received header: %d %d %d %d %d %d %d\n",
     lenR, compressedR, encryptedR, eccR,
@@ -216,15 +146,9 @@ int main(void)
 
   int numErrorsR = 0;
 
-  int8_t data_outR[10 * BYTES_PER_BEAT];
-
-  for (i = 0; i < lenR; i++) { 
-    uint64_t output = reg_read64(READQ_R);
-
+  for (i = 0; i < lenR; i++) {
     for (j = 0; j < BYTES_PER_BEAT; j++) {
-      int8_t out_data = output & 0xFF;
-      data_outR[i * BYTES_PER_BEAT + j] = out_data;
-      output = output >> BYTES_PER_BEAT;
+      int8_t out_data = data_outR[i * BYTES_PER_BEAT + j];
       printf("OUT: (i=%d, j=%d) creecR=%d, gold=%d\n",
              i, j, out_data, data[i * BYTES_PER_BEAT +j]);
       if (out_data != data[i * BYTES_PER_BEAT + j]) {
@@ -240,6 +164,51 @@ int main(void)
     printf("creecR FAILED with %d mismatches!\n", numErrorsR);
   }
 
+  // Mixed traffic: keep a write-path and a read-path transaction in flight
+  // at the same time, servicing whichever queue has room or data
+  int8_t data_outW2[10 * BYTES_PER_BEAT];
+  int8_t data_outR2[10 * BYTES_PER_BEAT];
+  creec_dev_t *devs[] = { &creecW, &creecR };
+
+  creec_req_t reqW2 = {
+    .header_in = { .len = len },
+    .src = data,
+    .dst = (uint8_t *)data_outW2,
+    .dst_bytes = sizeof(data_outW2),
+    .flags = CREEC_F_STREAM,
+  };
+  creec_req_t reqR2 = {
+    .header_in = reqW.header_out,
+    .src = (uint8_t *)data_outW,
+    .dst = (uint8_t *)data_outR2,
+    .dst_bytes = sizeof(data_outR2),
+    .flags = CREEC_F_STREAM,
+  };
+  creec_submit(&creecW, &reqW2);
+  creec_submit(&creecR, &reqR2);
+  creec_wait_all_irq(devs, 2);
+
+  int numErrorsMixed = 0;
+
+  if (reqW2.status != CREEC_REQ_DONE || reqW2.header_out.len != lenW ||
+      reqR2.status != CREEC_REQ_DONE || reqR2.header_out.len != lenR) {
+    numErrorsMixed += 1;
+  }
+  for (i = 0; i < lenW * BYTES_PER_BEAT; i++) {
+    if (data_outW2[i] != gold_data[i])
+      numErrorsMixed += 1;
+  }
+  for (i = 0; i < lenR * BYTES_PER_BEAT; i++) {
+    if (data_outR2[i] != (int8_t)data[i])
+      numErrorsMixed += 1;
+  }
+
+  if (numErrorsMixed == 0) {
+    printf("creecW+creecR PASSED!\n");
+  } else {
+    printf("creecW+creecR FAILED with %d mismatches!\n", numErrorsMixed);
+  }
+
   printf("Done!\n");
 	return 0;
 }
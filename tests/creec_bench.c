@@ -0,0 +1,126 @@
+#include <stdio.h>
+
+#include "libcreec.h"
+#include "util.h"
+
+// Sweep transfer size and data entropy over both pipelines and report, for
+// each point, cycles and MMIO accesses per input byte and the mean and best
+// submit-to-completion latency over REPS back-to-back transactions.
+//
+// The write pipeline always compresses, encrypts and ECC-encodes, and the
+// read pipeline always runs the inverse chain: the header flags are outputs
+// of the stages, not enables, so the stage combinations measurable on this
+// hardware are the two pipelines.
+#define REPS       4
+#define MAX_BYTES  (CREECW_MAX_BEATS * BYTES_PER_BEAT)
+// Room for the worst case expansion of incompressible data plus ECC parity
+#define OUT_BYTES  (8 * MAX_BYTES)
+
+static uint8_t src[MAX_BYTES] __attribute__((aligned(64)));
+static uint8_t enc[OUT_BYTES] __attribute__((aligned(64)));
+static uint8_t dec[OUT_BYTES] __attribute__((aligned(64)));
+
+enum { DATA_ZEROS, DATA_TEXT, DATA_RANDOM, NUM_DATA };
+static const char *data_names[NUM_DATA] = { "zeros", "text", "random" };
+
+static const char text[] =
+  "The quick brown fox jumps over the lazy dog. Sphinx of black quartz, "
+  "judge my vow. ";
+
+static void fill(int kind, uint32_t bytes)
+{
+  uint64_t x = 0x2545F4914F6CDD1DUL;
+  uint32_t i;
+
+  for (i = 0; i < bytes; i++) {
+    switch (kind) {
+      case DATA_ZEROS:
+        src[i] = 0;
+        break;
+      case DATA_TEXT:
+        src[i] = text[i % (sizeof(text) - 1)];
+        break;
+      default:
+        x = lfsr(x);
+        src[i] = x & 0xFF;
+        break;
+    }
+  }
+}
+
+// Returns 0 if every repetition completed without overflowing dst
+static int measure(const char *path, const char *data, creec_dev_t *dev,
+                   creec_req_t *req)
+{
+  uint32_t bytes = req->header_in.len * BYTES_PER_BEAT;
+  uint32_t ops = dev->mmio_ops;
+  unsigned long total = 0, best = -1UL, cpb, opb;
+  int r;
+
+  for (r = 0; r < REPS; r++) {
+    unsigned long t = read_csr(mcycle);
+    creec_submit(dev, req);
+    if (creec_wait(dev, req) != CREEC_REQ_DONE) {
+      printf("%-5s %-6s %5u FAILED\n", path, data, bytes);
+      return -1;
+    }
+    t = read_csr(mcycle) - t;
+    total += t;
+    if (t < best)
+      best = t;
+  }
+  ops = dev->mmio_ops - ops;
+
+  cpb = 100 * total / (REPS * bytes);
+  opb = 100 * (unsigned long)ops / (REPS * bytes);
+  printf("%-5s %-6s %5u %5lu.%02lu %3lu.%02lu %8lu %8lu\n", path, data, bytes,
+         cpb / 100, cpb % 100, opb / 100, opb % 100, total / REPS, best);
+  return 0;
+}
+
+int main(void)
+{
+  creec_dev_t creecW, creecR;
+  int kind, failed = 0;
+  uint32_t beats;
+
+  creec_init_write(&creecW);
+  creec_init_read(&creecR);
+
+  printf("path  data   bytes cyc/byte mmio/B  lat_avg lat_best\n");
+  for (kind = 0; kind < NUM_DATA; kind++) {
+    for (beats = 1; beats <= CREECW_MAX_BEATS; beats *= 2) {
+      fill(kind, beats * BYTES_PER_BEAT);
+
+      creec_req_t reqW = {
+        .header_in = { .len = beats },
+        .src = src,
+        .dst = enc,
+        .dst_bytes = sizeof(enc),
+        .flags = CREEC_F_STREAM,
+      };
+      if (measure("write", data_names[kind], &creecW, &reqW) < 0) {
+        failed++;
+        continue;
+      }
+
+      // Decode what the write pipeline produced
+      creec_req_t reqR = {
+        .header_in = reqW.header_out,
+        .src = enc,
+        .dst = dec,
+        .dst_bytes = sizeof(dec),
+        .flags = CREEC_F_STREAM,
+      };
+      if (reqR.header_in.len > CREECR_MAX_BEATS) {
+        printf("read  %-6s %5u skipped, %u beats encoded\n",
+               data_names[kind], beats * BYTES_PER_BEAT, reqR.header_in.len);
+        continue;
+      }
+      if (measure("read", data_names[kind], &creecR, &reqR) < 0)
+        failed++;
+    }
+  }
+
+  return failed;
+}
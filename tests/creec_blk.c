@@ -0,0 +1,76 @@
+#include <stdio.h>
+
+#include "libcreec.h"
+
+#define NSECTORS 8
+#define FIRST    2
+#define COUNT    4
+
+static creec_sector_t sectors[NSECTORS];
+static creec_cache_t cache;
+static uint8_t wbuf[COUNT * CREEC_SECTOR_BYTES] __attribute__((aligned(64)));
+static uint8_t rbuf[NSECTORS * CREEC_SECTOR_BYTES] __attribute__((aligned(64)));
+
+int main(void)
+{
+  creec_dev_t creecW, creecR;
+  creec_blk_t blk;
+  uint32_t i, lba;
+  int numErrors = 0;
+
+  creec_init_write(&creecW);
+  creec_init_read(&creecR);
+  creec_blk_init(&blk, &creecW, &creecR, sectors, NSECTORS);
+  creec_blk_cache(&blk, &cache);
+
+  // Compressible contents that differ from sector to sector
+  for (i = 0; i < sizeof(wbuf); i++)
+    wbuf[i] = (i / CREEC_SECTOR_BYTES) + ((i / 16) % 4);
+
+  if (creec_write_sectors(&blk, FIRST, COUNT, wbuf) < 0) {
+    printf("creec_write_sectors failed\n");
+    numErrors++;
+  }
+  if (creec_read_sectors(&blk, 0, NSECTORS, rbuf) < 0) {
+    printf("creec_read_sectors failed\n");
+    numErrors++;
+  }
+
+  for (lba = 0; lba < NSECTORS; lba++) {
+    int mismatches = 0;
+    for (i = 0; i < CREEC_SECTOR_BYTES; i++) {
+      uint8_t expected = 0;
+      if (lba >= FIRST && lba < FIRST + COUNT)
+        expected = wbuf[(lba - FIRST) * CREEC_SECTOR_BYTES + i];
+      if (rbuf[lba * CREEC_SECTOR_BYTES + i] != expected)
+        mismatches++;
+    }
+    printf("sector %u: %u encoded beats, %d mismatches\n",
+           lba, sectors[lba].header.len, mismatches);
+    numErrors += mismatches;
+  }
+
+  // The second read is served from the cache; rewriting a sector must
+  // invalidate its cached copy
+  if (creec_read_sectors(&blk, FIRST, COUNT, rbuf) < 0)
+    numErrors++;
+  for (i = 0; i < CREEC_SECTOR_BYTES; i++)
+    wbuf[i] = ~wbuf[i];
+  if (creec_write_sectors(&blk, FIRST, 1, wbuf) < 0 ||
+      creec_read_sectors(&blk, FIRST, 1, rbuf) < 0)
+    numErrors++;
+  for (i = 0; i < CREEC_SECTOR_BYTES; i++)
+    numErrors += rbuf[i] != wbuf[i];
+
+  printf("cache: %u hits, %u misses, %u evictions, %u invalidations\n",
+         cache.hits, cache.misses, cache.evictions, cache.invalidations);
+  if (cache.hits != COUNT || cache.invalidations != 1)
+    numErrors++;
+
+  if (numErrors == 0) {
+    printf("creec_blk PASSED!\n");
+  } else {
+    printf("creec_blk FAILED with %d errors!\n", numErrors);
+  }
+  return numErrors;
+}
@@ -1,3 +1,10 @@
+#ifndef __CREEC_CONFIGS_H
+#define __CREEC_CONFIGS_H
+
+#define BYTE_WIDTH 8
+#define BYTES_PER_BEAT 8
+#define BEAT_WIDTH (BYTES_PER_BEAT * BYTE_WIDTH)
+
 #define WRITEQ_W                0x2000
 #define WRITEQ_COUNT_W          0x2008
 #define READQ_W                 0x2100
@@ -8,6 +15,15 @@
 #define READQ_R                 0x2300
 #define READQ_COUNT_R           0x2308
 
+// Offset of the occupancy register within a WRITEQ_*/READQ_* window
+#define QUEUE_COUNT_OFFSET      0x08
+// Depth of the TLWriteQueue/TLReadQueue instances in CREECeleratorThing
+#define CREEC_QUEUE_DEPTH       8
+// 64-byte burst window within a queue: each beat written to (read from)
+// slot i of the window enqueues (dequeues) one entry, in slot order
+#define QUEUE_BURST_OFFSET      0x40
+#define QUEUE_BURST_BEATS       8
+
 #define CREECW_ENABLE           0x2400
 #define CREECR_ENABLE           0x2500
 
@@ -26,3 +42,46 @@
 #define CR_PADBYTES_OUT_OFFSET  0x30
 #define E_PADBYTES_OUT_OFFSET   0x34
 #define ECC_PADBYTES_OUT_OFFSET 0x38
+
+// Interrupt control
+#define INT_ENABLE_OFFSET       0x3c
+#define INT_PENDING_OFFSET      0x40
+#define RQ_WATERMARK_OFFSET     0x44
+// Packed header registers, see creec_pack_header()
+#define HEADER_IN_OFFSET        0x48
+#define HEADER_OUT_OFFSET       0x50
+#define HEADER_START            (1UL << 35)
+// Sector address of the next transaction, incremented by the hardware as
+// each header is accepted
+#define ADDR_IN_OFFSET          0x58
+
+#define CREEC_INT_HEADER        (1 << 0)
+#define CREEC_INT_WATERMARK     (1 << 1)
+
+// DMA engines
+#define CREECW_DMA              0x2600
+#define CREECR_DMA              0x2700
+
+#define DMA_ENABLE_OFFSET       0x00
+#define DMA_RING_BASE_OFFSET    0x08
+#define DMA_COMP_BASE_OFFSET    0x10
+#define DMA_RING_MASK_OFFSET    0x18
+#define DMA_HEAD_OFFSET         0x1c
+#define DMA_TAIL_OFFSET         0x20
+#define DMA_BUSY_OFFSET         0x24
+
+// PLIC sources of creecW and creecR. Sources 1 and 2 are the external
+// interrupts of ExampleTop (NExtTopInterrupts), so check the generated
+// .dts if the subsystem configuration changes.
+#define CREECW_IRQ              3
+#define CREECR_IRQ              4
+
+// Largest transaction (in beats) accepted by each pipeline, from
+// BusParams.blockDev and BusParams.creec respectively
+#define CREECW_MAX_BEATS        64
+#define CREECR_MAX_BEATS        128
+
+// Sector size of the block API; one sector fills a write transaction
+#define CREEC_SECTOR_BYTES      512
+
+#endif //__CREEC_CONFIGS_H
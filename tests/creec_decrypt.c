@@ -13,6 +13,11 @@
 #define CREECR_CR_PADBYTES_IN   0x2218
 #define CREECR_E_PADBYTES_IN    0x221c
 #define CREECR_ECC_PADBYTES_IN  0x2220
+#define CREECR_INT_ENABLE       0x2224
+#define CREECR_INT_PENDING      0x2228
+
+// PLIC source of creecR in TestHarnessRead (after the two external interrupts)
+#define CREECR_IRQ              3
 
 
 #define BEAT_WIDTH 64 // 64-bit per beat
@@ -20,7 +25,9 @@
 
 #include <stdio.h>
 
+#include "encoding.h"
 #include "mmio.h"
+#include "plic.h"
 
 int main(void)
 {
@@ -54,6 +61,14 @@ int main(void)
   reg_write32(CREECR_E_PADBYTES_IN, 8);
   reg_write32(CREECR_ECC_PADBYTES_IN, 0);
 
+  // Wake up from wfi on the output header interrupt. mstatus.MIE stays
+  // clear, so no trap is taken and the source is claimed right here.
+  plic_enable(CREECR_IRQ, 1);
+  reg_write32(PLIC_THRESHOLD, 0);
+  set_csr(mie, MIP_MEIP);
+  reg_write32(CREECR_INT_PENDING, 1);
+  reg_write32(CREECR_INT_ENABLE, 1);
+
   reg_write32(CREECR_NUM_BEATS_IN, len);
   reg_write32(CREECR_ENABLE, 1);
 
@@ -68,21 +83,20 @@ int main(void)
     printf("done\n");
   }
   printf("DONE\n");
-  uint16_t counter = 0;
-  int state = 0;
-  while (state == 0) {
-//    printf("write count %d\n", reg_read32(CREECR_WRITE_COUNT));
-//    printf("write block count %d\n", reg_read32(CREECR_NUM_BEATS_IN));
-//    printf("read  block count %d\n", reg_read32(CREECR_NUM_BEATS_OUT));
-//    printf("read  count %d\n", reg_read32(CREECR_READ_COUNT));
-    state = reg_read32(CREECR_NUM_BEATS_OUT) == 0 ? 1 : 0;
-
-    counter += 1;
-    if (i % 10 == 0) {
-        printf("counter %d\n", counter);
+  uint32_t irq;
+  uint16_t wakeups = 0;
+  while ((irq = plic_claim()) != CREECR_IRQ) {
+    if (irq != 0) {
+      plic_complete(irq);
+    } else {
+      asm volatile ("wfi");
+      wakeups += 1;
     }
   }
-  printf("finished at counter %d\n", counter);
+  reg_write32(CREECR_INT_ENABLE, 0);
+  reg_write32(CREECR_INT_PENDING, 1);
+  plic_complete(irq);
+  printf("finished after %d wakeups\n", wakeups);
 
   // Receive the CREECBus transaction header from creecR
   int out_len = reg_read32(CREECR_READ_COUNT);
@@ -0,0 +1,135 @@
+#include <stdio.h>
+
+#include "libcreec.h"
+
+#define RING_SIZE 4
+// Transactions per pipeline: NUM_DMA back-to-back descriptors, then one
+// through the MMIO registers of the same block, which must not be held up
+// by the DMA transactions before it
+#define NUM_DMA 2
+#define NUM_RUNS (NUM_DMA + 1)
+
+static creec_dma_desc_t ringW[RING_SIZE], ringR[RING_SIZE];
+static creec_dma_comp_t compW[RING_SIZE], compR[RING_SIZE];
+
+static int check(const char *name, int run, const int8_t *out,
+                 const int8_t *gold, uint32_t bytes)
+{
+  int i, numErrors = 0;
+
+  for (i = 0; i < bytes; i++) {
+    if (out[i] != gold[i]) {
+      numErrors += 1;
+      printf("Mismatch at byte %d: %s[%d]=%d, gold=%d\n",
+             i, name, run, out[i], gold[i]);
+    }
+  }
+
+  if (numErrors == 0) {
+    printf("%s run %d PASSED!\n", name, run);
+  } else {
+    printf("%s run %d FAILED with %d mismatches!\n", name, run, numErrors);
+  }
+  return numErrors;
+}
+
+int main(void)
+{
+  static uint8_t data[] __attribute__((aligned(64))) = {
+                    1, 2, 3, 4, 5, 6, 7, 8,
+                    2, 2, 2, 2, 2, 2, 2, 2,
+                    2, 2, 2, 2, 2, 2, 2, 2,
+                    0, 0, 0, 0, 0, 0, 0, 0,
+                    0, 0, 0, 0, 0, 0, 0, 3,
+                    3, 4, 4, 4, 4, 4, 4, 4};
+
+  // This is the golden result obtained from applying Compression, Encryption,
+  // and ECC on data
+  int8_t gold_data[] = {31, 30, -88, -97, -3, -25, -53, 11,
+                       -27, 97, 110, 35, 93, 81, 101, 76,
+                       53, 90, 59, 62, -125, 20, -11, 67,
+                       114, 79, 17, 32, 78, 26, 18, 1,
+                       46, 55, 96, -75, -52, 33, 59, -41,
+                       48, -20, -127, -36, 107, 69, -102, -8,
+                       -30, -85, 3, 112, -15, -21, 6, 25,
+                       10, -107, 88, 26, 109, -71, -85, -99};
+
+  static int8_t data_outW[NUM_RUNS][10 * BYTES_PER_BEAT] __attribute__((aligned(64)));
+  static int8_t data_outR[NUM_RUNS][10 * BYTES_PER_BEAT] __attribute__((aligned(64)));
+
+  int i, numErrors = 0;
+  creec_dma_t dmaW, dmaR;
+  creec_dev_t creecW, creecR;
+  creec_header_t headerW[NUM_RUNS];
+  creec_header_t header_in = { .len = sizeof(data) / BYTES_PER_BEAT };
+
+  if (creec_dma_init(&dmaW, CREECW_DMA, ringW, compW, RING_SIZE) < 0 ||
+      creec_dma_init(&dmaR, CREECR_DMA, ringR, compR, RING_SIZE) < 0) {
+    printf("creec DMA FAILED: bad ring size\n");
+    return 1;
+  }
+  creec_init_write(&creecW);
+  creec_init_read(&creecR);
+
+  for (i = 0; i < NUM_DMA; i++)
+    creec_dma_submit(&dmaW, &header_in, data, data_outW[i], sizeof(data_outW[i]));
+  for (i = 0; i < NUM_DMA; i++) {
+    if (creec_dma_wait(&dmaW, &headerW[i]) != CREEC_REQ_DONE)
+      printf("creecW DMA overflow!\n");
+  }
+
+  creec_req_t reqW = {
+    .header_in = header_in,
+    .src = data,
+    .dst = (uint8_t *)data_outW[NUM_DMA],
+    .dst_bytes = sizeof(data_outW[NUM_DMA]),
+  };
+  creec_submit(&creecW, &reqW);
+  if (creec_wait(&creecW, &reqW) != CREEC_REQ_DONE)
+    printf("creecW overflow!\n");
+  headerW[NUM_DMA] = reqW.header_out;
+
+  for (i = 0; i < NUM_RUNS; i++) {
+    printf("Received header: %d %d %d %d %d %d %d\n",
+      headerW[i].len, headerW[i].compressed, headerW[i].encrypted,
+      headerW[i].ecc, headerW[i].compressed_pad_bytes,
+      headerW[i].encrypted_pad_bytes, headerW[i].ecc_pad_bytes);
+    if (headerW[i].len * BYTES_PER_BEAT != sizeof(gold_data)) {
+      printf("creecW run %d FAILED: output length %d\n", i, headerW[i].len);
+      numErrors += 1;
+      continue;
+    }
+    numErrors += check("creecW", i, data_outW[i], gold_data, sizeof(gold_data));
+  }
+
+  for (i = 0; i < NUM_DMA; i++)
+    creec_dma_submit(&dmaR, &headerW[i], data_outW[i], data_outR[i],
+                     sizeof(data_outR[i]));
+  for (i = 0; i < NUM_DMA; i++) {
+    if (creec_dma_wait(&dmaR, NULL) != CREEC_REQ_DONE)
+      printf("creecR DMA overflow!\n");
+  }
+
+  creec_req_t reqR = {
+    .header_in = headerW[NUM_DMA],
+    .src = (uint8_t *)data_outW[NUM_DMA],
+    .dst = (uint8_t *)data_outR[NUM_DMA],
+    .dst_bytes = sizeof(data_outR[NUM_DMA]),
+  };
+  creec_submit(&creecR, &reqR);
+  if (creec_wait(&creecR, &reqR) != CREEC_REQ_DONE)
+    printf("creecR overflow!\n");
+
+  for (i = 0; i < NUM_RUNS; i++)
+    numErrors += check("creecR", i, data_outR[i], (const int8_t *)data,
+                       sizeof(data));
+
+  if (numErrors == 0) {
+    printf("creec DMA PASSED!\n");
+  } else {
+    printf("creec DMA FAILED!\n");
+  }
+
+  printf("Done!\n");
+	return 0;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+
+#include "libcreec.h"
+#include "util.h"
+
+// Keep DEPTH requests in flight over both pipelines, each one a write
+// followed by a read of its output, and report the latency percentiles of
+// each pipeline. Transfer sizes vary from 1 to MAX_BEATS beats, so requests
+// queue behind others of different lengths.
+#define NREQS      1024
+#define DEPTH      4
+#define MAX_BEATS  8
+#define BYTES      (MAX_BEATS * BYTES_PER_BEAT)
+#define OUT_BYTES  (8 * BYTES)
+
+static uint8_t src[DEPTH][BYTES] __attribute__((aligned(64)));
+static uint8_t enc[DEPTH][OUT_BYTES] __attribute__((aligned(64)));
+static uint8_t dec[DEPTH][OUT_BYTES] __attribute__((aligned(64)));
+static creec_lat_t latW, latR;
+
+static const char text[] =
+  "The quick brown fox jumps over the lazy dog. Sphinx of black quartz, "
+  "judge my vow. ";
+
+int main(void)
+{
+  creec_dev_t creecW, creecR;
+  creec_dev_t *devs[] = { &creecW, &creecR };
+  creec_req_t reqW[DEPTH], reqR[DEPTH];
+  uint64_t x = 0x2545F4914F6CDD1DUL;
+  uint32_t issued = 0, completed = 0, i, j;
+  int numErrors = 0;
+
+  creec_init_write(&creecW);
+  creec_init_read(&creecR);
+  creec_lat_enable(&creecW, &latW);
+  creec_lat_enable(&creecR, &latR);
+
+  for (i = 0; i < DEPTH; i++) {
+    reqW[i].status = CREEC_REQ_FREE;
+    reqR[i].status = CREEC_REQ_FREE;
+  }
+
+  while (completed < NREQS) {
+    creec_service(devs, 2);
+
+    for (i = 0; i < DEPTH; i++) {
+      if (reqR[i].status == CREEC_REQ_DONE) {
+        for (j = 0; j < reqW[i].header_in.len * BYTES_PER_BEAT; j++) {
+          if (dec[i][j] != src[i][j]) {
+            numErrors++;
+            break;
+          }
+        }
+        reqR[i].status = CREEC_REQ_FREE;
+        reqW[i].status = CREEC_REQ_FREE;
+        completed++;
+      }
+
+      if (reqW[i].status == CREEC_REQ_FREE && reqR[i].status == CREEC_REQ_FREE &&
+          issued < NREQS) {
+        uint32_t off;
+
+        x = lfsr(x);
+        off = (x >> 8) % (sizeof(text) - 1);
+        for (j = 0; j < BYTES; j++)
+          src[i][j] = text[(off + j) % (sizeof(text) - 1)];
+
+        creec_req_t req = {
+          .header_in = { .len = 1 + x % MAX_BEATS },
+          .src = src[i],
+          .dst = enc[i],
+          .dst_bytes = OUT_BYTES,
+          .flags = CREEC_F_STREAM,
+        };
+        reqW[i] = req;
+        creec_submit(&creecW, &reqW[i]);
+        issued++;
+      } else if (reqW[i].status == CREEC_REQ_DONE &&
+                 reqR[i].status == CREEC_REQ_FREE) {
+        creec_req_t req = {
+          .header_in = reqW[i].header_out,
+          .src = enc[i],
+          .dst = dec[i],
+          .dst_bytes = OUT_BYTES,
+          .flags = CREEC_F_STREAM,
+        };
+        reqR[i] = req;
+        creec_submit(&creecR, &reqR[i]);
+      } else if (reqW[i].status == CREEC_REQ_OVERFLOW ||
+                 reqR[i].status == CREEC_REQ_OVERFLOW) {
+        numErrors++;
+        reqW[i].status = CREEC_REQ_FREE;
+        reqR[i].status = CREEC_REQ_FREE;
+        completed++;
+      }
+    }
+  }
+
+  creec_lat_print(&latW, "creecW");
+  creec_lat_print(&latR, "creecR");
+
+  if (numErrors == 0) {
+    printf("creec_lat PASSED!\n");
+  } else {
+    printf("creec_lat FAILED with %d errors!\n", numErrors);
+  }
+  return numErrors;
+}
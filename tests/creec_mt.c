@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libcreec.h"
+#include "util.h"
+
+// Hart 0 owns both pipelines; every other hart produces requests for them
+// through its own pair of SPSC rings. With a single hart, hart 0 produces
+// requests itself and services them while it waits.
+#define MAX_HARTS 4
+#define RING_SIZE 4
+#define ROUNDS    4
+
+static uint8_t data[] = {1, 2, 3, 4, 5, 6, 7, 8,
+                         2, 2, 2, 2, 2, 2, 2, 2,
+                         2, 2, 2, 2, 2, 2, 2, 2,
+                         0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 3,
+                         3, 4, 4, 4, 4, 4, 4, 4};
+
+// This is the golden result obtained from applying Compression, Encryption,
+// and ECC on data
+static int8_t gold_data[] = {31, 30, -88, -97, -3, -25, -53, 11,
+                             -27, 97, 110, 35, 93, 81, 101, 76,
+                             53, 90, 59, 62, -125, 20, -11, 67,
+                             114, 79, 17, 32, 78, 26, 18, 1,
+                             46, 55, 96, -75, -52, 33, 59, -41,
+                             48, -20, -127, -36, 107, 69, -102, -8,
+                             -30, -85, 3, 112, -15, -21, 6, 25,
+                             10, -107, 88, 26, 109, -71, -85, -99};
+
+static creec_dev_t creecW, creecR;
+static creec_spsc_t ringW[MAX_HARTS], ringR[MAX_HARTS];
+static creec_req_t *slotsW[MAX_HARTS][RING_SIZE], *slotsR[MAX_HARTS][RING_SIZE];
+
+static volatile int producers_left;
+static int errors[MAX_HARTS];
+
+static void owner_service(int nc)
+{
+  creec_dev_t *devs[] = { &creecW, &creecR };
+  int i;
+
+  for (i = 0; i < nc; i++) {
+    creec_spsc_drain(&ringW[i], &creecW);
+    creec_spsc_drain(&ringR[i], &creecR);
+  }
+  creec_service(devs, 2);
+}
+
+static creec_req_status_t run(int cid, int nc, creec_spsc_t *ring,
+                              creec_req_t *req)
+{
+  while (creec_spsc_submit(ring, req) < 0) {
+    if (cid == 0)
+      owner_service(nc);
+  }
+  if (cid == 0) {
+    while (req->status == CREEC_REQ_QUEUED || req->status == CREEC_REQ_RUNNING)
+      owner_service(nc);
+  }
+  return creec_spsc_wait(req);
+}
+
+// Encode data on the write path, decode the result on the read path, and
+// count mismatches against gold_data and data
+static void produce(int cid, int nc)
+{
+  int8_t outW[10 * BYTES_PER_BEAT];
+  uint8_t outR[10 * BYTES_PER_BEAT];
+  creec_req_t reqW = { .status = CREEC_REQ_FREE };
+  creec_req_t reqR = { .status = CREEC_REQ_FREE };
+  int round, i;
+
+  for (round = 0; round < ROUNDS; round++) {
+    reqW.header_in = (creec_header_t){ .len = sizeof(data) / BYTES_PER_BEAT };
+    reqW.src = data;
+    reqW.dst = (uint8_t *)outW;
+    reqW.dst_bytes = sizeof(outW);
+    reqW.flags = CREEC_F_STREAM;
+    if (run(cid, nc, &ringW[cid], &reqW) != CREEC_REQ_DONE) {
+      errors[cid]++;
+      continue;
+    }
+    for (i = 0; i < sizeof(gold_data); i++)
+      errors[cid] += outW[i] != gold_data[i];
+
+    reqR.header_in = reqW.header_out;
+    reqR.src = (uint8_t *)outW;
+    reqR.dst = outR;
+    reqR.dst_bytes = sizeof(outR);
+    reqR.flags = CREEC_F_STREAM;
+    if (run(cid, nc, &ringR[cid], &reqR) != CREEC_REQ_DONE) {
+      errors[cid]++;
+      continue;
+    }
+    for (i = 0; i < sizeof(data); i++)
+      errors[cid] += outR[i] != data[i];
+  }
+}
+
+void thread_entry(int cid, int nc)
+{
+  int i, total = 0;
+
+  if (nc > MAX_HARTS)
+    nc = MAX_HARTS;
+  if (cid >= nc)
+    while (1);
+
+  if (cid == 0) {
+    creec_init_write(&creecW);
+    creec_init_read(&creecR);
+    for (i = 0; i < nc; i++) {
+      creec_spsc_init(&ringW[i], slotsW[i], RING_SIZE);
+      creec_spsc_init(&ringR[i], slotsR[i], RING_SIZE);
+    }
+    producers_left = nc - 1;
+  }
+  barrier(nc);
+
+  if (nc == 1) {
+    produce(0, 1);
+  } else if (cid == 0) {
+    while (producers_left != 0)
+      owner_service(nc);
+  } else {
+    produce(cid, nc);
+    __sync_fetch_and_add(&producers_left, -1);
+  }
+  barrier(nc);
+
+  if (cid != 0)
+    while (1);
+
+  for (i = 0; i < nc; i++) {
+    printf("hart %d: %d mismatches\n", i, errors[i]);
+    total += errors[i];
+  }
+  if (total == 0) {
+    printf("creec_mt PASSED!\n");
+  } else {
+    printf("creec_mt FAILED with %d mismatches!\n", total);
+  }
+  exit(total);
+}
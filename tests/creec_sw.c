@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "libcreec.h"
+#include "util.h"
+
+// Check the software codec against the pipelines, then push a burst of write
+// requests through creec_submit_hybrid() and compare the cycles it takes with
+// the same burst on the hardware alone.
+#define NREQS       8
+#define BEATS       16
+#define BYTES       (BEATS * BYTES_PER_BEAT)
+#define OUT_BYTES   (8 * BYTES)
+#define MAX_QUEUED  2
+
+static uint8_t src[NREQS][BYTES] __attribute__((aligned(64)));
+static uint8_t hw[NREQS][OUT_BYTES] __attribute__((aligned(64)));
+static uint8_t sw[NREQS][OUT_BYTES] __attribute__((aligned(64)));
+static uint8_t dec[OUT_BYTES] __attribute__((aligned(64)));
+
+// syscalls.c has no memcmp()
+static int differ(const uint8_t *a, const uint8_t *b, uint32_t n)
+{
+  uint32_t i;
+
+  for (i = 0; i < n; i++) {
+    if (a[i] != b[i])
+      return 1;
+  }
+  return 0;
+}
+
+static int same_header(const creec_header_t *a, const creec_header_t *b)
+{
+  return a->len == b->len && a->compressed == b->compressed &&
+         a->encrypted == b->encrypted && a->ecc == b->ecc &&
+         a->compressed_pad_bytes == b->compressed_pad_bytes &&
+         a->encrypted_pad_bytes == b->encrypted_pad_bytes &&
+         a->ecc_pad_bytes == b->ecc_pad_bytes;
+}
+
+static unsigned long burst(creec_dev_t *dev, creec_req_t *reqs,
+                           uint32_t max_queued)
+{
+  unsigned long t = read_csr(mcycle);
+  int i;
+
+  for (i = 0; i < NREQS; i++) {
+    creec_req_t req = {
+      .header_in = { .len = BEATS },
+      .src = src[i],
+      .dst = hw[i],
+      .dst_bytes = OUT_BYTES,
+      .flags = CREEC_F_STREAM,
+    };
+    reqs[i] = req;
+    creec_submit_hybrid(dev, &reqs[i], max_queued);
+  }
+  for (i = 0; i < NREQS; i++)
+    creec_wait(dev, &reqs[i]);
+  return read_csr(mcycle) - t;
+}
+
+int main(void)
+{
+  creec_dev_t creecW, creecR;
+  creec_req_t reqs[NREQS];
+  creec_header_t header, header_r;
+  uint64_t x = 0x2545F4914F6CDD1DUL;
+  unsigned long t_hw, t_hybrid;
+  int i, j, numErrors = 0;
+
+  creec_init_write(&creecW);
+  creec_init_read(&creecR);
+  creec_sw_init();
+
+  // Sparse, partly repetitive data so the run-length coder has work to do
+  for (i = 0; i < NREQS; i++) {
+    for (j = 0; j < BYTES; j++) {
+      x = lfsr(x);
+      src[i][j] = (x & 3) ? 0 : (uint8_t)(x >> 8) * (i + 1);
+    }
+  }
+
+  // Hardware only, which also gives the reference output
+  t_hw = burst(&creecW, reqs, -1U);
+  for (i = 0; i < NREQS; i++) {
+    if (reqs[i].status != CREEC_REQ_DONE ||
+        creec_sw_write(&reqs[i].header_in, src[i], sw[i], OUT_BYTES,
+                       &header) < 0 ||
+        !same_header(&header, &reqs[i].header_out) ||
+        differ(sw[i], hw[i], header.len * BYTES_PER_BEAT)) {
+      printf("write %d: software output differs\n", i);
+      numErrors++;
+      continue;
+    }
+
+    // Decode the software output in hardware and vice versa
+    creec_req_t reqR = {
+      .header_in = header,
+      .src = sw[i],
+      .dst = dec,
+      .dst_bytes = sizeof(dec),
+      .flags = CREEC_F_STREAM,
+    };
+    creec_submit(&creecR, &reqR);
+    if (creec_wait(&creecR, &reqR) != CREEC_REQ_DONE ||
+        differ(dec, src[i], BYTES) ||
+        creec_sw_read(&header, hw[i], sw[i], OUT_BYTES, &header_r) < 0 ||
+        !same_header(&header_r, &reqR.header_out) ||
+        differ(sw[i], src[i], BYTES)) {
+      printf("read %d: software output differs\n", i);
+      numErrors++;
+    }
+  }
+
+  // Hybrid: with MAX_QUEUED requests in the pipeline the rest go to the core
+  memset(hw, 0, sizeof(hw));
+  t_hybrid = burst(&creecW, reqs, MAX_QUEUED);
+  for (i = 0; i < NREQS; i++) {
+    creec_sw_write(&reqs[i].header_in, src[i], sw[i], OUT_BYTES, &header);
+    if (reqs[i].status != CREEC_REQ_DONE ||
+        !same_header(&header, &reqs[i].header_out) ||
+        differ(sw[i], hw[i], header.len * BYTES_PER_BEAT))
+      numErrors++;
+  }
+
+  printf("hardware: %lu cycles, hybrid: %lu cycles, %u of %d in software\n",
+         t_hw, t_hybrid, creecW.sw_reqs, NREQS);
+
+  if (numErrors == 0) {
+    printf("creec_sw PASSED!\n");
+  } else {
+    printf("creec_sw FAILED with %d errors!\n", numErrors);
+  }
+  return numErrors;
+}
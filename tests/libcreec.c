@@ -0,0 +1,541 @@
+#include <stddef.h>
+
+#include "encoding.h"
+#include "libcreec.h"
+#include "mmio.h"
+#include "plic.h"
+#include "trace.h"
+
+#define MCAUSE_INT (1UL << (__riscv_xlen - 1))
+#define CREEC_MAX_IRQ 8
+
+extern void __attribute__((noreturn)) tohost_exit(uintptr_t code);
+
+// PLIC source -> device, for handle_trap()
+static creec_dev_t *creec_irq_devs[CREEC_MAX_IRQ];
+
+// Caller buffers are accessed a word at a time whatever their declared type
+typedef uint64_t __attribute__((may_alias)) creec_word_t;
+
+void creec_header_write(uintptr_t ctrl, const creec_header_t *header) {
+  reg_write64(ctrl + HEADER_IN_OFFSET, creec_pack_header(header));
+}
+
+void creec_header_start(uintptr_t ctrl, const creec_header_t *header) {
+  reg_write64(ctrl + HEADER_IN_OFFSET, creec_pack_header(header) | HEADER_START);
+}
+
+void creec_header_read(uintptr_t ctrl, creec_header_t *header) {
+  creec_unpack_header(header, reg_read64(ctrl + HEADER_OUT_OFFSET));
+}
+
+uint64_t creec_pack_header(const creec_header_t *header) {
+  return (uint64_t)header->len |
+         ((uint64_t)(header->compressed & 1) << 32) |
+         ((uint64_t)(header->encrypted & 1) << 33) |
+         ((uint64_t)(header->ecc & 1) << 34) |
+         ((uint64_t)(header->compressed_pad_bytes & 0xFF) << 40) |
+         ((uint64_t)(header->encrypted_pad_bytes & 0xFF) << 48) |
+         ((uint64_t)(header->ecc_pad_bytes & 0xFF) << 56);
+}
+
+void creec_unpack_header(creec_header_t *header, uint64_t word) {
+  header->len                  = word & 0xFFFFFFFF;
+  header->compressed           = (word >> 32) & 1;
+  header->encrypted            = (word >> 33) & 1;
+  header->ecc                  = (word >> 34) & 1;
+  header->compressed_pad_bytes = (word >> 40) & 0xFF;
+  header->encrypted_pad_bytes  = (word >> 48) & 0xFF;
+  header->ecc_pad_bytes        = (word >> 56) & 0xFF;
+}
+
+uint64_t creec_pack_beat(const uint8_t *src, int i) {
+  int j;
+  uint64_t result = 0;
+  for (j = i * BYTES_PER_BEAT; j < (i + 1) * BYTES_PER_BEAT; j++) {
+    result = (result >> BYTE_WIDTH) |
+             ((uint64_t)src[j] << (BEAT_WIDTH - BYTE_WIDTH));
+  }
+  return result;
+}
+
+void creec_unpack_beat(uint8_t *dst, uint64_t beat) {
+  int j;
+  for (j = 0; j < BYTES_PER_BEAT; j++) {
+    dst[j] = beat & 0xFF;
+    beat = beat >> BYTE_WIDTH;
+  }
+}
+
+void creec_init(creec_dev_t *dev, uintptr_t ctrl, uintptr_t writeq,
+                uintptr_t readq, uint32_t max_beats) {
+  dev->ctrl = ctrl;
+  dev->writeq = writeq;
+  dev->readq = readq;
+  dev->max_beats = max_beats;
+  dev->irq = 0;
+  dev->irq_count = 0;
+  dev->mmio_ops = 0;
+  dev->sw_reqs = 0;
+  dev->next_addr = 0;
+  dev->lat = NULL;
+  reg_write32(ctrl + ADDR_IN_OFFSET, 0);
+  dev->head = NULL;
+  dev->tail = NULL;
+}
+
+void creec_init_write(creec_dev_t *dev) {
+  creec_init(dev, CREECW_ENABLE, WRITEQ_W, READQ_W, CREECW_MAX_BEATS);
+}
+
+void creec_init_read(creec_dev_t *dev) {
+  creec_init(dev, CREECR_ENABLE, WRITEQ_R, READQ_R, CREECR_MAX_BEATS);
+}
+
+int creec_busy(const creec_dev_t *dev) {
+  return dev->head != NULL;
+}
+
+// Beats are little endian, so a beat is just a 64-bit load. An unaligned one
+// is put together from the two aligned words it straddles; both hold bytes of
+// the beat, so this never reads past the aligned word holding its last byte.
+static inline uint64_t creec_load_beat(const uint8_t *p) {
+  uint32_t shift = ((uintptr_t)p & (BYTES_PER_BEAT - 1)) * BYTE_WIDTH;
+  const creec_word_t *w = (const creec_word_t *)
+                          ((uintptr_t)p & ~(uintptr_t)(BYTES_PER_BEAT - 1));
+
+  if (shift == 0)
+    return w[0];
+  return (w[0] >> shift) | (w[1] << (BEAT_WIDTH - shift));
+}
+
+void creec_queue_write(uintptr_t writeq, const uint8_t *src, uint32_t n) {
+  volatile uint64_t *win = (volatile uint64_t *)(writeq + QUEUE_BURST_OFFSET);
+  uint32_t i;
+
+  if ((uintptr_t)src & (BYTES_PER_BEAT - 1)) {
+    for (i = 0; i < n; i++)
+      win[i % QUEUE_BURST_BEATS] = creec_load_beat(src + i * BYTES_PER_BEAT);
+    return;
+  }
+
+  const creec_word_t *s = (const creec_word_t *)src;
+  for (; n >= QUEUE_BURST_BEATS; n -= QUEUE_BURST_BEATS, s += QUEUE_BURST_BEATS) {
+    win[0] = s[0]; win[1] = s[1]; win[2] = s[2]; win[3] = s[3];
+    win[4] = s[4]; win[5] = s[5]; win[6] = s[6]; win[7] = s[7];
+  }
+  for (i = 0; i < n; i++)
+    win[i] = s[i];
+}
+
+void creec_queue_read(uintptr_t readq, uint8_t *dst, uint32_t n) {
+  volatile uint64_t *win = (volatile uint64_t *)(readq + QUEUE_BURST_OFFSET);
+  uint32_t i;
+
+  if ((uintptr_t)dst & (BYTES_PER_BEAT - 1)) {
+    for (i = 0; i < n; i++)
+      creec_unpack_beat(dst + i * BYTES_PER_BEAT, win[i % QUEUE_BURST_BEATS]);
+    return;
+  }
+
+  creec_word_t *d = (creec_word_t *)dst;
+  for (; n >= QUEUE_BURST_BEATS; n -= QUEUE_BURST_BEATS, d += QUEUE_BURST_BEATS) {
+    d[0] = win[0]; d[1] = win[1]; d[2] = win[2]; d[3] = win[3];
+    d[4] = win[4]; d[5] = win[5]; d[6] = win[6]; d[7] = win[7];
+  }
+  for (i = 0; i < n; i++)
+    d[i] = win[i];
+}
+
+uint32_t creec_iov_bytes(const creec_iovec_t *iov, uint32_t cnt) {
+  uint32_t i, bytes = 0;
+  for (i = 0; i < cnt; i++)
+    bytes += iov[i].len;
+  return bytes;
+}
+
+static void creec_iov_init(creec_iov_cursor_t *c, const creec_iovec_t *iov,
+                           uint32_t cnt) {
+  c->iov = iov;
+  c->cnt = cnt;
+  c->idx = 0;
+  c->off = 0;
+}
+
+// Step over fragments that are used up. Returns 0 at the end of the array.
+static int creec_iov_skip(creec_iov_cursor_t *c) {
+  while (c->idx < c->cnt && c->off == c->iov[c->idx].len) {
+    c->idx++;
+    c->off = 0;
+  }
+  return c->idx < c->cnt;
+}
+
+// Gather the next beat. Only a beat that straddles two fragments, or runs
+// past the last one, is put together a byte at a time.
+static uint64_t creec_iov_load(creec_iov_cursor_t *c) {
+  uint64_t beat = 0;
+  uint32_t got;
+
+  if (!creec_iov_skip(c))
+    return 0;
+  if (c->iov[c->idx].len - c->off >= BYTES_PER_BEAT) {
+    beat = creec_load_beat((const uint8_t *)c->iov[c->idx].base + c->off);
+    c->off += BYTES_PER_BEAT;
+    return beat;
+  }
+
+  for (got = 0; got < BYTES_PER_BEAT && creec_iov_skip(c); got++) {
+    const uint8_t *p = c->iov[c->idx].base;
+    beat |= (uint64_t)p[c->off++] << (got * BYTE_WIDTH);
+  }
+  return beat;
+}
+
+// Scatter one beat. Bytes past the last fragment are dropped.
+static void creec_iov_store(creec_iov_cursor_t *c, uint64_t beat) {
+  uint32_t put;
+
+  if (!creec_iov_skip(c))
+    return;
+  uint8_t *p = (uint8_t *)c->iov[c->idx].base + c->off;
+  if (c->iov[c->idx].len - c->off >= BYTES_PER_BEAT &&
+      ((uintptr_t)p & (BYTES_PER_BEAT - 1)) == 0) {
+    *(creec_word_t *)p = beat;
+    c->off += BYTES_PER_BEAT;
+    return;
+  }
+
+  for (put = 0; put < BYTES_PER_BEAT && creec_iov_skip(c); put++) {
+    p = c->iov[c->idx].base;
+    p[c->off++] = beat & 0xFF;
+    beat = beat >> BYTE_WIDTH;
+  }
+}
+
+// Record cycle stamp i of req (see creec_req_t.lat_ts) if dev keeps
+// latency histograms
+static inline void creec_lat_stamp(creec_dev_t *dev, creec_req_t *req, int i) {
+  if (dev->lat)
+    req->lat_ts[i] = rdcycle();
+}
+
+// Push n input beats of req, starting at beats_in
+static void creec_push(creec_dev_t *dev, creec_req_t *req, uint32_t n) {
+  volatile uint64_t *win;
+  uint32_t i;
+
+  if (!req->src_iov) {
+    creec_queue_write(dev->writeq, req->src + req->beats_in * BYTES_PER_BEAT, n);
+  } else {
+    win = (volatile uint64_t *)(dev->writeq + QUEUE_BURST_OFFSET);
+    for (i = 0; i < n; i++)
+      win[i % QUEUE_BURST_BEATS] = creec_iov_load(&req->src_cur);
+  }
+  req->beats_in += n;
+  dev->mmio_ops += n;
+  if (n && req->beats_in == req->header_in.len)
+    creec_lat_stamp(dev, req, 2);
+}
+
+// Push as many input beats as currently fit in the write queue
+static void creec_stream_in(creec_dev_t *dev, creec_req_t *req) {
+  uint32_t room, left;
+
+  if (req->beats_in == req->header_in.len)
+    return;
+
+  room = CREEC_QUEUE_DEPTH - reg_read32(dev->writeq + QUEUE_COUNT_OFFSET);
+  dev->mmio_ops++;
+  left = req->header_in.len - req->beats_in;
+  creec_push(dev, req, room < left ? room : left);
+}
+
+// Hand the header of req to the block, followed by its input beats. The
+// header and the start bit go out in a single packed write, preceded by an
+// ADDR_IN write only for a CREEC_F_ADDR request whose addr does not follow
+// on from the previous one. The block increments ADDR_IN after each header.
+// The enable bit is cleared by the hardware once the header is accepted, so
+// this may be called again as soon as the previous transaction has been
+// drained.
+static void creec_start(creec_dev_t *dev, creec_req_t *req) {
+  req->status = CREEC_REQ_RUNNING;
+  req->beats_in = 0;
+  req->beats_out = 0;
+  req->header_out.len = 0;
+  creec_iov_init(&req->src_cur, req->src_iov, req->src_iovcnt);
+  creec_iov_init(&req->dst_cur, req->dst_iov, req->dst_iovcnt);
+  if ((req->flags & CREEC_F_ADDR) && req->header_in.addr != dev->next_addr) {
+    reg_write32(dev->ctrl + ADDR_IN_OFFSET, req->header_in.addr);
+    dev->mmio_ops++;
+    dev->next_addr = req->header_in.addr;
+  }
+  dev->next_addr++;
+  trace(TRACE_CREEC_START, dev->ctrl >> 8, req->header_in.len);
+  creec_header_start(dev->ctrl, &req->header_in);
+  dev->mmio_ops++;
+  creec_lat_stamp(dev, req, 1);
+
+  if (req->flags & CREEC_F_STREAM) {
+    creec_stream_in(dev, req);
+  } else {
+    creec_push(dev, req, req->header_in.len);
+  }
+}
+
+// Move n output beats from the read queue into dst. Beats that do not fit
+// are still drained, otherwise the block never returns to sSendHeader.
+static void creec_drain(creec_dev_t *dev, creec_req_t *req, uint32_t n) {
+  uint32_t room, fit;
+
+  if (n)
+    trace(TRACE_CREEC_DRAIN, dev->ctrl >> 8, n);
+  dev->mmio_ops += n;
+  if (req->dst_iov) {
+    volatile uint64_t *win = (volatile uint64_t *)(dev->readq + QUEUE_BURST_OFFSET);
+    uint32_t i;
+    for (i = 0; i < n; i++)
+      creec_iov_store(&req->dst_cur, win[i % QUEUE_BURST_BEATS]);
+    req->beats_out += n;
+    return;
+  }
+
+  room = req->dst_bytes / BYTES_PER_BEAT;
+  fit = room > req->beats_out ? room - req->beats_out : 0;
+
+  if (fit > n)
+    fit = n;
+  creec_queue_read(dev->readq, req->dst + req->beats_out * BYTES_PER_BEAT, fit);
+  req->beats_out += n;
+  for (n -= fit; n > 0; n--)
+    reg_read64(dev->readq);
+}
+
+// Advance the head request. Returns 1 once all of its output is collected.
+static int creec_progress(creec_dev_t *dev, creec_req_t *req) {
+  int stream = req->flags & CREEC_F_STREAM;
+
+  if (stream)
+    creec_stream_in(dev, req);
+
+  // NUM_BEATS_OUT stays zero until the output header arrives, so a single
+  // read of the packed header both checks for and fetches it
+  if (req->header_out.len == 0) {
+    creec_header_read(dev->ctrl, &req->header_out);
+    dev->mmio_ops++;
+    if (req->header_out.len == 0)
+      return 0;
+    req->header_out.addr = req->header_in.addr;
+    req->out_bytes = req->header_out.len * BYTES_PER_BEAT;
+    trace(TRACE_CREEC_HEADER, dev->ctrl >> 8, req->header_out.len);
+    creec_lat_stamp(dev, req, 3);
+  }
+
+  if (stream) {
+    uint32_t avail = reg_read32(dev->readq + QUEUE_COUNT_OFFSET);
+    dev->mmio_ops++;
+    uint32_t left = req->header_out.len - req->beats_out;
+    creec_drain(dev, req, avail < left ? avail : left);
+  } else {
+    // Blocking reads: each one waits for the next beat to arrive
+    creec_drain(dev, req, req->header_out.len - req->beats_out);
+  }
+
+  if (req->beats_out < req->header_out.len)
+    return 0;
+
+  // Another hart may be waiting on status: publish the output first
+  __sync_synchronize();
+  req->status = req->out_bytes > req->dst_bytes ?
+                CREEC_REQ_OVERFLOW : CREEC_REQ_DONE;
+  return 1;
+}
+
+int creec_submit(creec_dev_t *dev, creec_req_t *req) {
+  if (req->status == CREEC_REQ_QUEUED || req->status == CREEC_REQ_RUNNING)
+    return -1;
+  return creec_enqueue(dev, req);
+}
+
+int creec_enqueue(creec_dev_t *dev, creec_req_t *req) {
+  if (req->header_in.len == 0 || req->header_in.len > dev->max_beats)
+    return -1;
+  // Blocking stores of more beats than the write queue holds would wait on
+  // output that is only drained after them
+  if (req->header_in.len > CREEC_QUEUE_DEPTH)
+    req->flags |= CREEC_F_STREAM;
+
+  if (req->src_iov && creec_iov_bytes(req->src_iov, req->src_iovcnt) >
+                      req->header_in.len * BYTES_PER_BEAT)
+    return -1;
+  if (req->dst_iov)
+    req->dst_bytes = creec_iov_bytes(req->dst_iov, req->dst_iovcnt);
+
+  req->next = NULL;
+  req->out_bytes = 0;
+  req->status = CREEC_REQ_QUEUED;
+  trace(TRACE_CREEC_SUBMIT, dev->ctrl >> 8, req->header_in.len);
+  creec_lat_stamp(dev, req, 0);
+
+  if (dev->tail) {
+    dev->tail->next = req;
+    dev->tail = req;
+  } else {
+    dev->head = dev->tail = req;
+    creec_start(dev, req);
+  }
+  return 0;
+}
+
+int creec_poll(creec_dev_t *dev) {
+  creec_req_t *req = dev->head;
+
+  if (!req || !creec_progress(dev, req))
+    return 0;
+
+  dev->head = req->next;
+  if (!dev->head)
+    dev->tail = NULL;
+  req->next = NULL;
+  trace(TRACE_CREEC_DONE, dev->ctrl >> 8, req->status);
+  if (dev->lat)
+    creec_lat_record(dev->lat, req, rdcycle());
+
+  if (req->complete)
+    req->complete(req);
+
+  if (dev->head)
+    creec_start(dev, dev->head);
+  return 1;
+}
+
+creec_req_status_t creec_wait(creec_dev_t *dev, creec_req_t *req) {
+  while (req->status == CREEC_REQ_QUEUED || req->status == CREEC_REQ_RUNNING)
+    creec_poll(dev);
+  return req->status;
+}
+
+void creec_irq_init(creec_dev_t *dev, uint32_t irq) {
+  if (irq == 0 || irq >= CREEC_MAX_IRQ)
+    return;
+  dev->irq = irq;
+  creec_irq_devs[irq] = dev;
+  reg_write32(dev->ctrl + INT_ENABLE_OFFSET, 0);
+  reg_write32(dev->ctrl + INT_PENDING_OFFSET, CREEC_INT_HEADER);
+  plic_enable(irq, 1);
+  reg_write32(PLIC_THRESHOLD, 0);
+  set_csr(mie, MIP_MEIP);
+}
+
+// Enable the interrupts that signal the next event req is waiting for. The
+// watermark is lowered to the number of beats still expected, so the tail of
+// a transaction shorter than half the queue still wakes us up.
+static void creec_irq_arm(creec_dev_t *dev, creec_req_t *req) {
+  uint32_t enable = CREEC_INT_HEADER;
+
+  if (req->header_out.len != 0) {
+    uint32_t left = req->header_out.len - req->beats_out;
+    uint32_t mark = CREEC_QUEUE_DEPTH / 2;
+    reg_write32(dev->ctrl + RQ_WATERMARK_OFFSET, left < mark ? left : mark);
+    dev->mmio_ops++;
+    enable |= CREEC_INT_WATERMARK;
+  }
+  reg_write32(dev->ctrl + INT_ENABLE_OFFSET, enable);
+  dev->mmio_ops++;
+}
+
+creec_req_status_t creec_wait_irq(creec_dev_t *dev, creec_req_t *req) {
+  while (req->status == CREEC_REQ_QUEUED || req->status == CREEC_REQ_RUNNING) {
+    creec_req_t *head;
+
+    // With MIE clear, wfi still returns once the interrupt is pending, and
+    // the trap is taken as soon as MIE is set again. An event that fires
+    // between creec_poll() and wfi therefore cannot be missed.
+    clear_csr(mstatus, MSTATUS_MIE);
+    creec_poll(dev);
+    head = dev->head;
+    if (head && head->beats_in == head->header_in.len &&
+        (req->status == CREEC_REQ_QUEUED || req->status == CREEC_REQ_RUNNING)) {
+      creec_irq_arm(dev, head);
+      asm volatile ("wfi");
+    }
+    set_csr(mstatus, MSTATUS_MIE);
+  }
+  return req->status;
+}
+
+int creec_service(creec_dev_t *const *devs, uint32_t n) {
+  uint32_t i;
+  int done = 0;
+
+  for (i = 0; i < n; i++)
+    done += creec_poll(devs[i]);
+  return done;
+}
+
+static int creec_any_busy(creec_dev_t *const *devs, uint32_t n) {
+  uint32_t i;
+
+  for (i = 0; i < n; i++) {
+    if (creec_busy(devs[i]))
+      return 1;
+  }
+  return 0;
+}
+
+void creec_wait_all(creec_dev_t *const *devs, uint32_t n) {
+  while (creec_any_busy(devs, n))
+    creec_service(devs, n);
+}
+
+void creec_wait_all_irq(creec_dev_t *const *devs, uint32_t n) {
+  while (creec_any_busy(devs, n)) {
+    uint32_t i;
+    int sleep = 0;
+
+    // Same MIE handling as creec_wait_irq(). Sleep only when no device
+    // still has input to push, as write queue space raises no interrupt.
+    clear_csr(mstatus, MSTATUS_MIE);
+    creec_service(devs, n);
+    for (i = 0; i < n; i++) {
+      creec_req_t *head = devs[i]->head;
+      if (!head)
+        continue;
+      if (head->beats_in != head->header_in.len) {
+        sleep = 0;
+        break;
+      }
+      sleep = 1;
+    }
+    if (sleep) {
+      for (i = 0; i < n; i++) {
+        if (devs[i]->head)
+          creec_irq_arm(devs[i], devs[i]->head);
+      }
+      asm volatile ("wfi");
+    }
+    set_csr(mstatus, MSTATUS_MIE);
+  }
+}
+
+uintptr_t handle_trap(uintptr_t cause, uintptr_t epc, uintptr_t regs[32]) {
+  uint32_t id;
+
+  if (cause != (MCAUSE_INT | IRQ_M_EXT))
+    tohost_exit(1337);
+
+  while ((id = plic_claim()) != 0) {
+    creec_dev_t *dev = id < CREEC_MAX_IRQ ? creec_irq_devs[id] : NULL;
+    trace(TRACE_CREEC_IRQ, id, 0);
+    if (dev) {
+      // Mask until the next creec_irq_arm(): the watermark interrupt is
+      // level sensitive and stays asserted until the queue is drained
+      reg_write32(dev->ctrl + INT_ENABLE_OFFSET, 0);
+      reg_write32(dev->ctrl + INT_PENDING_OFFSET, CREEC_INT_HEADER);
+      dev->irq_count++;
+      dev->mmio_ops += 2;
+    }
+    plic_complete(id);
+  }
+  return epc;
+}
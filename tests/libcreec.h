@@ -0,0 +1,431 @@
+#ifndef __LIBCREEC_H
+#define __LIBCREEC_H
+
+#include <stdint.h>
+
+#include "creec_configs.h"
+
+// Mirror of the CREECBus TransactionHeader fields that are exposed through
+// the CREECeleratorBlock regmap. len is in beats (BYTES_PER_BEAT bytes each),
+// addr is the sector address; the driver copies it to header_out.
+typedef struct {
+  uint32_t len;
+  uint32_t addr;
+  uint32_t compressed;
+  uint32_t encrypted;
+  uint32_t ecc;
+  uint32_t compressed_pad_bytes;
+  uint32_t encrypted_pad_bytes;
+  uint32_t ecc_pad_bytes;
+} creec_header_t;
+
+typedef enum {
+  CREEC_REQ_FREE = 0,   // never submitted, or already reaped
+  CREEC_REQ_QUEUED,     // waiting behind another request on the same block
+  CREEC_REQ_RUNNING,    // header and data handed to the hardware
+  CREEC_REQ_DONE,       // output header and data collected
+  CREEC_REQ_OVERFLOW    // done, but the output did not fit in dst
+} creec_req_status_t;
+
+// Request flags
+// CREEC_F_STREAM: cut-through transfer. Input beats are pushed only while
+// the write queue has room and output beats are drained as soon as they
+// reach the read queue, using the WRITEQ_COUNT/READQ_COUNT registers, so
+// transactions longer than CREEC_QUEUE_DEPTH never stall the core on a
+// full queue. Without it all input is written up front with blocking
+// stores, which costs fewer MMIO reads for short transactions; requests
+// longer than CREEC_QUEUE_DEPTH are always streamed, as their input would
+// not fit in the write queue before the output is drained.
+#define CREEC_F_STREAM          (1 << 0)
+// CREEC_F_ADDR: header_in.addr is a sector address the block must see.
+// Without it the block's address register is left as it is, and header_out
+// still carries header_in.addr.
+#define CREEC_F_ADDR            (1 << 1)
+
+// Scatter-gather buffer, as in struct iovec
+typedef struct {
+  void *base;
+  uint32_t len;
+} creec_iovec_t;
+
+// Position within an array of creec_iovec_t
+typedef struct {
+  const creec_iovec_t *iov;
+  uint32_t cnt;
+  uint32_t idx;
+  uint32_t off;
+} creec_iov_cursor_t;
+
+typedef struct creec_req creec_req_t;
+typedef struct creec_lat creec_lat_t;
+
+// Request descriptor. The caller fills in header_in, src, dst, dst_bytes and
+// flags, and must keep the descriptor and both buffers alive until the request
+// leaves the QUEUED/RUNNING states. header_out and out_bytes are written by
+// the driver on completion.
+//
+// Instead of src, the input may be gathered from src_iov: the fragments are
+// concatenated and zero padded to header_in.len beats, and read in place with
+// 64-bit loads, whatever their alignment. Likewise a non-NULL dst_iov
+// replaces dst, and dst_bytes is set to its total length on submit.
+struct creec_req {
+  creec_header_t header_in;
+  const uint8_t *src;        // header_in.len * BYTES_PER_BEAT bytes
+  uint8_t *dst;
+  uint32_t dst_bytes;
+  uint32_t flags;
+
+  const creec_iovec_t *src_iov;
+  uint32_t src_iovcnt;
+  const creec_iovec_t *dst_iov;
+  uint32_t dst_iovcnt;
+
+  creec_header_t header_out;
+  uint32_t out_bytes;
+  volatile creec_req_status_t status;
+
+  // Transfer progress, in beats, while the request is RUNNING
+  uint32_t beats_in;
+  uint32_t beats_out;
+  creec_iov_cursor_t src_cur;
+  creec_iov_cursor_t dst_cur;
+  // Cycle stamps of submit, header written, last input beat pushed and
+  // output header seen, when the device keeps latency histograms
+  unsigned long lat_ts[4];
+
+  // Optional completion callback, called from creec_poll()
+  void (*complete)(creec_req_t *req);
+  void *priv;
+
+  creec_req_t *next;
+};
+
+// One CREECeleratorBlock together with its write and read queues
+typedef struct {
+  uintptr_t ctrl;            // CREECW_ENABLE / CREECR_ENABLE
+  uintptr_t writeq;          // WRITEQ_W / WRITEQ_R
+  uintptr_t readq;           // READQ_W / READQ_R
+  uint32_t max_beats;        // largest header len accepted by the pipeline
+  uint32_t irq;              // PLIC source, 0 when interrupts are not used
+  volatile uint32_t irq_count;
+  // Device MMIO accesses made on behalf of requests, for benchmarks
+  volatile uint32_t mmio_ops;
+  // Requests completed by the software codec instead, see creec_submit_hybrid()
+  uint32_t sw_reqs;
+  // ADDR_IN value the hardware will use for the next transaction
+  uint32_t next_addr;
+  // Latency histograms, NULL unless creec_lat_enable() was called
+  creec_lat_t *lat;
+
+  // Submitted requests in FIFO order; head is the one in the hardware
+  creec_req_t *head;
+  creec_req_t *tail;
+} creec_dev_t;
+
+void creec_init(creec_dev_t *dev, uintptr_t ctrl, uintptr_t writeq,
+                uintptr_t readq, uint32_t max_beats);
+void creec_init_write(creec_dev_t *dev);
+void creec_init_read(creec_dev_t *dev);
+
+// Queue req on dev. If the block is idle the transaction is started right
+// away, otherwise it starts once every earlier request has completed.
+// Returns 0 on success, -1 if the request is malformed.
+int creec_submit(creec_dev_t *dev, creec_req_t *req);
+
+// Make progress on dev without blocking on the pipeline. Returns the number
+// of requests that completed during this call.
+int creec_poll(creec_dev_t *dev);
+
+// Poll dev until req has completed. Returns the final status of req.
+creec_req_status_t creec_wait(creec_dev_t *dev, creec_req_t *req);
+
+// Route the header and read queue watermark interrupts of dev through the
+// PLIC to hart 0. Once registered, the handle_trap() in libcreec.c masks the
+// device interrupt and acknowledges it; other traps still exit with 1337.
+void creec_irq_init(creec_dev_t *dev, uint32_t irq);
+
+// Like creec_wait(), but sleeps in wfi between pipeline events instead of
+// polling NUM_BEATS_OUT. Requires creec_irq_init() on dev. While input beats
+// of a CREEC_F_STREAM request are still pending it falls back to polling,
+// since write queue space does not raise an interrupt.
+creec_req_status_t creec_wait_irq(creec_dev_t *dev, creec_req_t *req);
+
+// creec_submit() without the check that req is not already in flight, for
+// requests handed over by another hart that marked them QUEUED itself
+int creec_enqueue(creec_dev_t *dev, creec_req_t *req);
+
+int creec_busy(const creec_dev_t *dev);
+
+// Several pipelines driven from one hart, e.g. a write path and a read path
+// with a transaction in flight on each. creec_service() makes one pass over
+// devs, pushing input wherever a write queue has room and draining output
+// wherever a read queue holds data, and returns the number of requests that
+// completed. Requests serviced this way should use CREEC_F_STREAM: a blocking
+// transfer on one pipeline stalls every other one until it finishes.
+int creec_service(creec_dev_t *const *devs, uint32_t n);
+
+// Service devs until none of them has a request left
+void creec_wait_all(creec_dev_t *const *devs, uint32_t n);
+
+// Like creec_wait_all(), but sleeps in wfi whenever every busy device is only
+// waiting for output. Requires creec_irq_init() on each device.
+void creec_wait_all_irq(creec_dev_t *const *devs, uint32_t n);
+
+// Descriptor-ring DMA (libcreec_dma.c). The engine fetches input beats from
+// src and writes output beats to dst itself, so a transaction costs the core
+// a handful of cached stores and one doorbell write instead of one MMIO
+// access per beat. Rings and buffers must be in DRAM; src and dst must be
+// 8-byte aligned, and bursts are largest when they are 64-byte aligned.
+typedef struct {
+  uint64_t src;
+  uint64_t dst;
+  uint64_t header;           // creec_pack_header()
+  uint64_t dst_beats;
+} __attribute__((aligned(32))) creec_dma_desc_t;
+
+#define CREEC_DMA_DONE          (1 << 0)
+#define CREEC_DMA_OVERFLOW      (1 << 1)
+
+typedef struct {
+  uint64_t header;           // creec_pack_header() of the output header
+  uint64_t status;           // CREEC_DMA_DONE | CREEC_DMA_OVERFLOW
+} __attribute__((aligned(16))) creec_dma_comp_t;
+
+typedef struct {
+  uintptr_t base;            // CREECW_DMA / CREECR_DMA
+  creec_dma_desc_t *ring;
+  creec_dma_comp_t *comp;
+  uint32_t size;             // entries in ring and comp, a power of two
+  uint32_t head;             // next descriptor to fill
+  uint32_t tail;             // next completion to reap
+} creec_dma_t;
+
+// size must be a non-zero power of two. Returns 0, or -1 for any other size,
+// in which case the engine is left alone.
+int creec_dma_init(creec_dma_t *dma, uintptr_t base, creec_dma_desc_t *ring,
+                   creec_dma_comp_t *comp, uint32_t size);
+
+// Append a descriptor and ring the doorbell. Returns the ring index of the
+// descriptor, or -1 if the ring is full or a buffer is misaligned.
+int creec_dma_submit(creec_dma_t *dma, const creec_header_t *header,
+                     const void *src, void *dst, uint32_t dst_bytes);
+
+// Reap the oldest outstanding descriptor if the engine has completed it.
+// Returns CREEC_REQ_DONE or CREEC_REQ_OVERFLOW and fills header_out (if not
+// NULL), or CREEC_REQ_RUNNING if it is still in flight, or CREEC_REQ_FREE if
+// nothing is outstanding.
+creec_req_status_t creec_dma_reap(creec_dma_t *dma, creec_header_t *header_out);
+
+// Reap the oldest outstanding descriptor, waiting for it if necessary
+creec_req_status_t creec_dma_wait(creec_dma_t *dma, creec_header_t *header_out);
+
+// Move n beats between a buffer and the burst window of a queue, eight
+// consecutive stores (loads) at a time. Blocks while the queue is full
+// (empty), like single-entry accesses. Buffers are always read with aligned
+// 64-bit loads; unaligned destinations are written a byte at a time.
+void creec_queue_write(uintptr_t writeq, const uint8_t *src, uint32_t n);
+void creec_queue_read(uintptr_t readq, uint8_t *dst, uint32_t n);
+
+// Total length of cnt fragments, in bytes
+uint32_t creec_iov_bytes(const creec_iovec_t *iov, uint32_t cnt);
+
+// Sector-level block API (libcreec_blk.c). A small block device backed by
+// DRAM: each sector is encoded by the write pipeline on the way in and the
+// encoded data is kept together with its output header, which the read
+// pipeline needs to decode it again. Sectors that were never written read
+// back as zeros.
+//
+// Up to CREEC_BLK_BATCH sectors are queued on a pipeline at once, and the
+// auto-incrementing ADDR_IN register means a run of consecutive sectors costs
+// a single address write. A transaction cannot span sectors: the write
+// pipeline takes at most CREECW_MAX_BEATS beats, exactly one sector, and each
+// encoded sector has padding of its own.
+#define CREEC_SECTOR_BEATS      (CREEC_SECTOR_BYTES / BYTES_PER_BEAT)
+#define CREEC_BLK_BATCH         8
+
+typedef struct {
+  creec_header_t header;     // write pipeline output, len 0 if never written
+  uint8_t data[CREECR_MAX_BEATS * BYTES_PER_BEAT];
+} __attribute__((aligned(64))) creec_sector_t;
+
+// Decoded-sector cache (libcreec_cache.c), optional for the block API. Hits
+// are served from DRAM without a trip through the read pipeline. Sectors are
+// located through a linear-probing index of 8-byte entries, twice as large as
+// the number of slots, and evicted with the CLOCK policy. Writing a sector
+// invalidates its cached copy.
+#ifndef CREEC_CACHE_INDEX_BITS
+#define CREEC_CACHE_INDEX_BITS  5
+#endif
+#define CREEC_CACHE_INDEX       (1 << CREEC_CACHE_INDEX_BITS)
+#define CREEC_CACHE_SLOTS       (CREEC_CACHE_INDEX / 2)
+#define CREEC_CACHE_EMPTY       0xFFFFFFFF
+
+typedef struct {
+  uint32_t lba;              // CREEC_CACHE_EMPTY if unused
+  uint32_t slot;
+} creec_cache_idx_t;
+
+typedef struct {
+  uint8_t data[CREEC_CACHE_SLOTS][CREEC_SECTOR_BYTES] __attribute__((aligned(64)));
+  creec_cache_idx_t index[CREEC_CACHE_INDEX];
+  uint32_t slot_lba[CREEC_CACHE_SLOTS];   // CREEC_CACHE_EMPTY if free
+  uint8_t ref[CREEC_CACHE_SLOTS];         // CLOCK reference bits
+  uint32_t hand;
+
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;
+  uint32_t invalidations;
+} creec_cache_t;
+
+void creec_cache_init(creec_cache_t *cache);
+
+// Copy sector lba into dst and return 0 if it is cached, else return -1.
+// Counts a hit or a miss.
+int creec_cache_lookup(creec_cache_t *cache, uint32_t lba, void *dst);
+
+// Cache a copy of the decoded sector lba, evicting another one if needed
+void creec_cache_insert(creec_cache_t *cache, uint32_t lba, const void *src);
+
+// Drop sector lba from the cache if it is there
+void creec_cache_invalidate(creec_cache_t *cache, uint32_t lba);
+
+typedef struct {
+  creec_dev_t *wdev;
+  creec_dev_t *rdev;
+  creec_sector_t *sectors;
+  uint32_t nsectors;
+  creec_cache_t *cache;      // NULL unless creec_blk_cache() was called
+  creec_req_t reqs[CREEC_BLK_BATCH];
+} creec_blk_t;
+
+void creec_blk_init(creec_blk_t *blk, creec_dev_t *wdev, creec_dev_t *rdev,
+                    creec_sector_t *sectors, uint32_t nsectors);
+
+// Serve reads of blk through cache, which is (re)initialized
+void creec_blk_cache(creec_blk_t *blk, creec_cache_t *cache);
+
+// Write (read) count sectors starting at lba from (into) buf, which holds
+// count * CREEC_SECTOR_BYTES bytes. Return 0 on success, -1 if the range is
+// out of bounds or a transaction failed.
+int creec_write_sectors(creec_blk_t *blk, uint32_t lba, uint32_t count,
+                        const void *buf);
+int creec_read_sectors(creec_blk_t *blk, uint32_t lba, uint32_t count,
+                       void *buf);
+
+// Multi-hart submission (libcreec_mt.c). The MMIO sequences of a device are
+// not safe to run from several harts at once, so each device is owned by a
+// single hart, which is the only one to call creec_submit()/creec_poll() on
+// it. Other harts hand requests to the owner through a lock-free
+// single-producer single-consumer ring in shared memory, one ring per
+// producer and device, and wait on the request status.
+typedef struct {
+  creec_req_t **slots;
+  uint32_t size;             // entries in slots, a power of two
+  volatile uint32_t head;    // written by the producer only
+  volatile uint32_t tail;    // written by the consumer only
+} creec_spsc_t;
+
+void creec_spsc_init(creec_spsc_t *ring, creec_req_t **slots, uint32_t size);
+
+// Producer: mark req QUEUED and pass it to the owner. Returns 0 on success,
+// -1 if the ring is full or req is still in flight.
+int creec_spsc_submit(creec_spsc_t *ring, creec_req_t *req);
+
+// Producer: spin until the owner has completed req. Returns its final status,
+// CREEC_REQ_FREE if the owner rejected it as malformed.
+creec_req_status_t creec_spsc_wait(creec_req_t *req);
+
+// Owner: move every request waiting in ring onto dev. Returns the number of
+// requests taken. Call creec_poll()/creec_service() to make progress on them.
+int creec_spsc_drain(creec_spsc_t *ring, creec_dev_t *dev);
+
+// Software codec (libcreec_sw.c), bit exact with the pipelines: the same
+// differential + run-length coding, AES-128 with the hardware key and RS(16,8)
+// code, and the same padding and output header. Encoding uses table-driven
+// AES and a one-word RS parity register; decoding checks the syndromes and
+// only runs the error corrector on codewords that need it. The tables are
+// built on first use, or up front by creec_sw_init(). Not reentrant: only the
+// hart owning the pipelines should call these.
+void creec_sw_init(void);
+
+// Run the write (read) pipeline transform on header_in->len beats of src,
+// writing the output to dst and its header to header_out. Returns 0, or -1
+// if the input is malformed or the output does not fit in dst_bytes.
+int creec_sw_write(const creec_header_t *header_in, const uint8_t *src,
+                   uint8_t *dst, uint32_t dst_bytes, creec_header_t *header_out);
+int creec_sw_read(const creec_header_t *header_in, const uint8_t *src,
+                  uint8_t *dst, uint32_t dst_bytes, creec_header_t *header_out);
+
+// Hybrid scheduling: submit req to dev like creec_submit(), unless dev
+// already holds max_queued or more requests, in which case the core runs it
+// through the software codec right away instead of waiting for the pipeline.
+// The request then completes before this returns, with its callback called,
+// and counts in dev->sw_reqs. Requests using iovecs, or whose output would
+// not fit in dst, always go to the hardware. Returns 0 if req was submitted,
+// 1 if it completed in software, -1 if it is malformed.
+int creec_submit_hybrid(creec_dev_t *dev, creec_req_t *req,
+                        uint32_t max_queued);
+
+// Request latency histograms (libcreec_lat.c). Once enabled on a device,
+// every request it completes is timestamped with rdcycle and its latency
+// split into phases:
+//   header:  submit until the header is written, including the time spent
+//            queued behind earlier requests
+//   input:   until the last input beat is pushed
+//   compute: until the output header appears
+//   drain:   until the last output beat is read
+// Each phase and the total go into a log-bucketed histogram with
+// 2^CREEC_LAT_SUB_BITS buckets per power of two, so percentiles are exact
+// to within 1/2^CREEC_LAT_SUB_BITS of their value. Requests completed by the
+// software codec are not counted.
+#ifndef CREEC_LAT_SUB_BITS
+#define CREEC_LAT_SUB_BITS      2
+#endif
+#define CREEC_LAT_BUCKETS       ((32 - CREEC_LAT_SUB_BITS + 1) << CREEC_LAT_SUB_BITS)
+
+enum {
+  CREEC_LAT_HEADER,
+  CREEC_LAT_INPUT,
+  CREEC_LAT_COMPUTE,
+  CREEC_LAT_DRAIN,
+  CREEC_LAT_TOTAL,
+  CREEC_LAT_PHASES
+};
+
+struct creec_lat {
+  uint32_t count;
+  uint32_t max[CREEC_LAT_PHASES];
+  uint32_t buckets[CREEC_LAT_PHASES][CREEC_LAT_BUCKETS];
+};
+
+// Clear lat and start recording the requests completed on dev into it.
+// Several devices may share one lat.
+void creec_lat_enable(creec_dev_t *dev, creec_lat_t *lat);
+
+// Record the phases of req, which completed at cycle now
+void creec_lat_record(creec_lat_t *lat, const creec_req_t *req,
+                      unsigned long now);
+
+// Upper bound, in cycles, of the permille-th permille of phase: 500 is the
+// median, 999 the 99.9th percentile. 0 if nothing was recorded.
+uint32_t creec_lat_percentile(const creec_lat_t *lat, int phase,
+                              uint32_t permille);
+
+// Print count, p50, p99, p99.9 and max of every phase
+void creec_lat_print(const creec_lat_t *lat, const char *name);
+
+// Raw register helpers. Headers go through the packed HEADER_IN/HEADER_OUT
+// registers, one 64-bit access each; creec_header_start() also sets the
+// start bit, so a transaction begins with a single MMIO write.
+void creec_header_write(uintptr_t ctrl, const creec_header_t *header);
+void creec_header_start(uintptr_t ctrl, const creec_header_t *header);
+void creec_header_read(uintptr_t ctrl, creec_header_t *header);
+uint64_t creec_pack_beat(const uint8_t *src, int i);
+// Header packed into one 64-bit word as in CREECDMAHeader and the packed
+// header registers
+uint64_t creec_pack_header(const creec_header_t *header);
+void creec_unpack_header(creec_header_t *header, uint64_t word);
+void creec_unpack_beat(uint8_t *dst, uint64_t beat);
+
+#endif //__LIBCREEC_H
@@ -0,0 +1,126 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "libcreec.h"
+
+void creec_blk_init(creec_blk_t *blk, creec_dev_t *wdev, creec_dev_t *rdev,
+                    creec_sector_t *sectors, uint32_t nsectors) {
+  uint32_t i;
+
+  blk->wdev = wdev;
+  blk->rdev = rdev;
+  blk->sectors = sectors;
+  blk->nsectors = nsectors;
+  blk->cache = NULL;
+  for (i = 0; i < nsectors; i++)
+    sectors[i].header.len = 0;
+  for (i = 0; i < CREEC_BLK_BATCH; i++)
+    blk->reqs[i].status = CREEC_REQ_FREE;
+}
+
+void creec_blk_cache(creec_blk_t *blk, creec_cache_t *cache) {
+  creec_cache_init(cache);
+  blk->cache = cache;
+}
+
+static int creec_blk_range(creec_blk_t *blk, uint32_t lba, uint32_t count) {
+  return lba < blk->nsectors && count <= blk->nsectors - lba;
+}
+
+int creec_write_sectors(creec_blk_t *blk, uint32_t lba, uint32_t count,
+                        const void *buf) {
+  const uint8_t *src = buf;
+  int ret = 0;
+
+  if (!creec_blk_range(blk, lba, count))
+    return -1;
+
+  while (count > 0) {
+    uint32_t n = count < CREEC_BLK_BATCH ? count : CREEC_BLK_BATCH;
+    uint32_t i;
+
+    // Queue the whole batch, then collect it in order
+    for (i = 0; i < n; i++) {
+      creec_req_t *req = &blk->reqs[i];
+      creec_sector_t *sector = &blk->sectors[lba + i];
+
+      sector->header.len = 0;
+      if (blk->cache)
+        creec_cache_invalidate(blk->cache, lba + i);
+      req->header_in = (creec_header_t){ .len = CREEC_SECTOR_BEATS,
+                                         .addr = lba + i };
+      req->src = src + i * CREEC_SECTOR_BYTES;
+      req->src_iov = NULL;
+      req->dst = sector->data;
+      req->dst_bytes = sizeof(sector->data);
+      req->dst_iov = NULL;
+      req->flags = CREEC_F_STREAM | CREEC_F_ADDR;
+      req->complete = NULL;
+      if (creec_submit(blk->wdev, req) < 0)
+        req->status = CREEC_REQ_FREE;
+    }
+    for (i = 0; i < n; i++) {
+      if (creec_wait(blk->wdev, &blk->reqs[i]) == CREEC_REQ_DONE)
+        blk->sectors[lba + i].header = blk->reqs[i].header_out;
+      else
+        ret = -1;
+    }
+
+    lba += n;
+    count -= n;
+    src += n * CREEC_SECTOR_BYTES;
+  }
+  return ret;
+}
+
+int creec_read_sectors(creec_blk_t *blk, uint32_t lba, uint32_t count,
+                       void *buf) {
+  uint8_t *dst = buf;
+  int ret = 0;
+
+  if (!creec_blk_range(blk, lba, count))
+    return -1;
+
+  while (count > 0) {
+    uint32_t n = count < CREEC_BLK_BATCH ? count : CREEC_BLK_BATCH;
+    uint32_t i, queued = 0;
+
+    for (i = 0; i < n; i++) {
+      creec_req_t *req = &blk->reqs[i];
+      creec_sector_t *sector = &blk->sectors[lba + i];
+
+      if (sector->header.len == 0) {
+        memset(dst + i * CREEC_SECTOR_BYTES, 0, CREEC_SECTOR_BYTES);
+        continue;
+      }
+      if (blk->cache && creec_cache_lookup(blk->cache, lba + i,
+                                           dst + i * CREEC_SECTOR_BYTES) == 0)
+        continue;
+      req->header_in = sector->header;
+      req->header_in.addr = lba + i;
+      req->src = sector->data;
+      req->src_iov = NULL;
+      req->dst = dst + i * CREEC_SECTOR_BYTES;
+      req->dst_bytes = CREEC_SECTOR_BYTES;
+      req->dst_iov = NULL;
+      req->flags = CREEC_F_STREAM | CREEC_F_ADDR;
+      req->complete = NULL;
+      if (creec_submit(blk->rdev, req) < 0)
+        req->status = CREEC_REQ_FREE;
+      queued |= 1 << i;
+    }
+    for (i = 0; i < n; i++) {
+      if (!(queued & (1 << i)))
+        continue;
+      if (creec_wait(blk->rdev, &blk->reqs[i]) != CREEC_REQ_DONE)
+        ret = -1;
+      else if (blk->cache)
+        creec_cache_insert(blk->cache, lba + i, dst + i * CREEC_SECTOR_BYTES);
+    }
+
+    lba += n;
+    count -= n;
+    dst += n * CREEC_SECTOR_BYTES;
+  }
+  return ret;
+}
@@ -0,0 +1,119 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "libcreec.h"
+
+#define CREEC_CACHE_MASK (CREEC_CACHE_INDEX - 1)
+
+// Fibonacci hashing: the top bits of the product are the well mixed ones
+static uint32_t creec_cache_hash(uint32_t lba) {
+  return (lba * 0x9E3779B1u) >> (32 - CREEC_CACHE_INDEX_BITS);
+}
+
+// Index position holding lba, or of the empty entry that ends its probe run
+static uint32_t creec_cache_find(const creec_cache_t *cache, uint32_t lba) {
+  uint32_t pos = creec_cache_hash(lba);
+
+  while (cache->index[pos].lba != CREEC_CACHE_EMPTY &&
+         cache->index[pos].lba != lba)
+    pos = (pos + 1) & CREEC_CACHE_MASK;
+  return pos;
+}
+
+// Remove the entry at pos, shifting later entries of the probe run back so
+// lookups never need tombstones
+static void creec_cache_remove(creec_cache_t *cache, uint32_t pos) {
+  uint32_t next = pos;
+
+  for (;;) {
+    uint32_t home;
+    int stays;
+
+    next = (next + 1) & CREEC_CACHE_MASK;
+    if (cache->index[next].lba == CREEC_CACHE_EMPTY)
+      break;
+    // An entry may only move back if its home is not in (pos, next]
+    home = creec_cache_hash(cache->index[next].lba);
+    stays = pos < next ? (pos < home && home <= next)
+                       : (pos < home || home <= next);
+    if (!stays) {
+      cache->index[pos] = cache->index[next];
+      pos = next;
+    }
+  }
+  cache->index[pos].lba = CREEC_CACHE_EMPTY;
+}
+
+void creec_cache_init(creec_cache_t *cache) {
+  uint32_t i;
+
+  for (i = 0; i < CREEC_CACHE_INDEX; i++)
+    cache->index[i].lba = CREEC_CACHE_EMPTY;
+  for (i = 0; i < CREEC_CACHE_SLOTS; i++) {
+    cache->slot_lba[i] = CREEC_CACHE_EMPTY;
+    cache->ref[i] = 0;
+  }
+  cache->hand = 0;
+  cache->hits = 0;
+  cache->misses = 0;
+  cache->evictions = 0;
+  cache->invalidations = 0;
+}
+
+int creec_cache_lookup(creec_cache_t *cache, uint32_t lba, void *dst) {
+  uint32_t pos = creec_cache_find(cache, lba);
+  uint32_t slot;
+
+  if (cache->index[pos].lba == CREEC_CACHE_EMPTY) {
+    cache->misses++;
+    return -1;
+  }
+  slot = cache->index[pos].slot;
+  cache->ref[slot] = 1;
+  cache->hits++;
+  memcpy(dst, cache->data[slot], CREEC_SECTOR_BYTES);
+  return 0;
+}
+
+void creec_cache_insert(creec_cache_t *cache, uint32_t lba, const void *src) {
+  uint32_t pos = creec_cache_find(cache, lba);
+  uint32_t slot;
+
+  if (cache->index[pos].lba == lba) {
+    slot = cache->index[pos].slot;
+  } else {
+    // CLOCK: sweep past recently used slots, clearing their reference bit
+    while (cache->slot_lba[cache->hand] != CREEC_CACHE_EMPTY &&
+           cache->ref[cache->hand]) {
+      cache->ref[cache->hand] = 0;
+      cache->hand = (cache->hand + 1) % CREEC_CACHE_SLOTS;
+    }
+    slot = cache->hand;
+    cache->hand = (cache->hand + 1) % CREEC_CACHE_SLOTS;
+
+    if (cache->slot_lba[slot] != CREEC_CACHE_EMPTY) {
+      creec_cache_remove(cache, creec_cache_find(cache, cache->slot_lba[slot]));
+      cache->evictions++;
+      // the victim may have shifted the empty entry lba probes to
+      pos = creec_cache_find(cache, lba);
+    }
+    cache->slot_lba[slot] = lba;
+    cache->index[pos].lba = lba;
+    cache->index[pos].slot = slot;
+  }
+  cache->ref[slot] = 1;
+  memcpy(cache->data[slot], src, CREEC_SECTOR_BYTES);
+}
+
+void creec_cache_invalidate(creec_cache_t *cache, uint32_t lba) {
+  uint32_t pos = creec_cache_find(cache, lba);
+  uint32_t slot;
+
+  if (cache->index[pos].lba == CREEC_CACHE_EMPTY)
+    return;
+  slot = cache->index[pos].slot;
+  creec_cache_remove(cache, pos);
+  cache->slot_lba[slot] = CREEC_CACHE_EMPTY;
+  cache->ref[slot] = 0;
+  cache->invalidations++;
+}
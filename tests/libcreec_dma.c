@@ -0,0 +1,91 @@
+#include <stddef.h>
+
+#include "libcreec.h"
+#include "mmio.h"
+
+int creec_dma_init(creec_dma_t *dma, uintptr_t base, creec_dma_desc_t *ring,
+                   creec_dma_comp_t *comp, uint32_t size) {
+  uint32_t i;
+
+  // Ring indices are masked with size - 1 by the driver and the engine
+  if (size == 0 || (size & (size - 1)) != 0)
+    return -1;
+
+  dma->base = base;
+  dma->ring = ring;
+  dma->comp = comp;
+  dma->size = size;
+
+  for (i = 0; i < size; i++)
+    comp[i].status = 0;
+
+  // Stop the engine and pick up where its tail register left off; slots are
+  // always taken as index & (size - 1) on both sides
+  reg_write32(base + DMA_ENABLE_OFFSET, 0);
+  while (reg_read32(base + DMA_BUSY_OFFSET))
+    ;
+  dma->tail = reg_read32(base + DMA_TAIL_OFFSET);
+  dma->head = dma->tail;
+  reg_write64(base + DMA_RING_BASE_OFFSET, (uintptr_t)ring);
+  reg_write64(base + DMA_COMP_BASE_OFFSET, (uintptr_t)comp);
+  reg_write32(base + DMA_RING_MASK_OFFSET, size - 1);
+  reg_write32(base + DMA_HEAD_OFFSET, dma->head);
+  reg_write32(base + DMA_ENABLE_OFFSET, 1);
+  return 0;
+}
+
+int creec_dma_submit(creec_dma_t *dma, const creec_header_t *header,
+                     const void *src, void *dst, uint32_t dst_bytes) {
+  uint32_t slot = dma->head & (dma->size - 1);
+  creec_dma_desc_t *desc = &dma->ring[slot];
+
+  if (dma->head - dma->tail == dma->size)
+    return -1;
+  if ((((uintptr_t)src | (uintptr_t)dst) & (BYTES_PER_BEAT - 1)) != 0)
+    return -1;
+  if (header->len == 0)
+    return -1;
+
+  desc->src = (uintptr_t)src;
+  desc->dst = (uintptr_t)dst;
+  desc->header = creec_pack_header(header);
+  desc->dst_beats = dst_bytes / BYTES_PER_BEAT;
+  dma->comp[slot].status = 0;
+
+  // Descriptor and completion slot must be visible before the doorbell
+  __sync_synchronize();
+  dma->head++;
+  reg_write32(dma->base + DMA_HEAD_OFFSET, dma->head);
+  return slot;
+}
+
+creec_req_status_t creec_dma_reap(creec_dma_t *dma, creec_header_t *header_out) {
+  uint32_t slot = dma->tail & (dma->size - 1);
+  volatile creec_dma_comp_t *comp = &dma->comp[slot];
+  uint64_t status;
+
+  if (dma->tail == dma->head)
+    return CREEC_REQ_FREE;
+
+  // Completion records are written through the coherent front bus, so this
+  // is an ordinary cached load rather than an MMIO round trip
+  status = comp->status;
+  if (!(status & CREEC_DMA_DONE))
+    return CREEC_REQ_RUNNING;
+
+  __sync_synchronize();
+  if (header_out)
+    creec_unpack_header(header_out, comp->header);
+  comp->status = 0;
+  dma->tail++;
+
+  return (status & CREEC_DMA_OVERFLOW) ? CREEC_REQ_OVERFLOW : CREEC_REQ_DONE;
+}
+
+creec_req_status_t creec_dma_wait(creec_dma_t *dma, creec_header_t *header_out) {
+  creec_req_status_t status;
+
+  while ((status = creec_dma_reap(dma, header_out)) == CREEC_REQ_RUNNING)
+    ;
+  return status;
+}
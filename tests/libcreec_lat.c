@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "libcreec.h"
+
+#define CREEC_LAT_SUB   (1 << CREEC_LAT_SUB_BITS)
+
+static const char *creec_lat_names[CREEC_LAT_PHASES] = {
+  "header", "input", "compute", "drain", "total"
+};
+
+// Values below CREEC_LAT_SUB get a bucket each; above that, every power of
+// two is split into CREEC_LAT_SUB buckets by the bits below the leading one
+static uint32_t creec_lat_bucket(uint32_t v) {
+  uint32_t msb;
+
+  if (v < CREEC_LAT_SUB)
+    return v;
+  msb = 31 - __builtin_clz(v);
+  return ((msb - CREEC_LAT_SUB_BITS + 1) << CREEC_LAT_SUB_BITS) +
+         ((v >> (msb - CREEC_LAT_SUB_BITS)) & (CREEC_LAT_SUB - 1));
+}
+
+// Largest value that falls into bucket b
+static uint32_t creec_lat_bucket_max(uint32_t b) {
+  uint32_t shift;
+
+  if (b < CREEC_LAT_SUB)
+    return b;
+  shift = (b >> CREEC_LAT_SUB_BITS) - 1;
+  return (((uint64_t)(CREEC_LAT_SUB + (b & (CREEC_LAT_SUB - 1))) + 1) << shift) - 1;
+}
+
+void creec_lat_enable(creec_dev_t *dev, creec_lat_t *lat) {
+  memset(lat, 0, sizeof(*lat));
+  dev->lat = lat;
+}
+
+void creec_lat_record(creec_lat_t *lat, const creec_req_t *req,
+                      unsigned long now) {
+  unsigned long ts[CREEC_LAT_PHASES + 1];
+  int i;
+
+  ts[0] = req->lat_ts[0];
+  ts[1] = req->lat_ts[1];
+  ts[2] = req->lat_ts[2];
+  ts[3] = req->lat_ts[3];
+  ts[4] = now;
+  // Stamps 2 and 3 are taken in that order by creec_progress(), but keep
+  // the phases non-negative whatever the order
+  if (ts[3] < ts[2])
+    ts[3] = ts[2];
+
+  lat->count++;
+  for (i = 0; i < CREEC_LAT_PHASES; i++) {
+    unsigned long d = i == CREEC_LAT_TOTAL ? now - ts[0] : ts[i + 1] - ts[i];
+    uint32_t v = d > 0xFFFFFFFFUL ? 0xFFFFFFFF : (uint32_t)d;
+    lat->buckets[i][creec_lat_bucket(v)]++;
+    if (v > lat->max[i])
+      lat->max[i] = v;
+  }
+}
+
+uint32_t creec_lat_percentile(const creec_lat_t *lat, int phase,
+                              uint32_t permille) {
+  // Smallest bucket holding at least permille/1000 of the samples
+  uint64_t rank = ((uint64_t)lat->count * permille + 999) / 1000;
+  uint64_t seen = 0;
+  uint32_t b;
+
+  if (!lat->count)
+    return 0;
+  if (!rank)
+    rank = 1;
+  for (b = 0; b < CREEC_LAT_BUCKETS; b++) {
+    seen += lat->buckets[phase][b];
+    if (seen >= rank)
+      break;
+  }
+  b = creec_lat_bucket_max(b);
+  return b < lat->max[phase] ? b : lat->max[phase];
+}
+
+void creec_lat_print(const creec_lat_t *lat, const char *name) {
+  int i;
+
+  printf("%s: %u requests, latency in cycles\n", name, lat->count);
+  printf("%-8s %8s %8s %8s %8s\n", "phase", "p50", "p99", "p99.9", "max");
+  for (i = 0; i < CREEC_LAT_PHASES; i++) {
+    printf("%-8s %8u %8u %8u %8u\n", creec_lat_names[i],
+           creec_lat_percentile(lat, i, 500), creec_lat_percentile(lat, i, 990),
+           creec_lat_percentile(lat, i, 999), lat->max[i]);
+  }
+}
@@ -0,0 +1,57 @@
+#include <stddef.h>
+
+#include "libcreec.h"
+
+// head and tail run freely and are only masked to index slots, so the ring
+// is full when they are size apart. The fences order the slot accesses
+// against the index updates that publish them to the other hart.
+
+void creec_spsc_init(creec_spsc_t *ring, creec_req_t **slots, uint32_t size) {
+  ring->slots = slots;
+  ring->size = size;
+  ring->head = 0;
+  ring->tail = 0;
+}
+
+int creec_spsc_submit(creec_spsc_t *ring, creec_req_t *req) {
+  uint32_t head = ring->head;
+
+  if (head - ring->tail == ring->size)
+    return -1;
+  if (req->status == CREEC_REQ_QUEUED || req->status == CREEC_REQ_RUNNING)
+    return -1;
+
+  req->status = CREEC_REQ_QUEUED;
+  ring->slots[head & (ring->size - 1)] = req;
+  __sync_synchronize();
+  ring->head = head + 1;
+  return 0;
+}
+
+creec_req_status_t creec_spsc_wait(creec_req_t *req) {
+  creec_req_status_t status;
+
+  while ((status = req->status) == CREEC_REQ_QUEUED ||
+         status == CREEC_REQ_RUNNING)
+    ;
+  // pairs with the fence before the owner's status write
+  __sync_synchronize();
+  return status;
+}
+
+int creec_spsc_drain(creec_spsc_t *ring, creec_dev_t *dev) {
+  uint32_t tail = ring->tail;
+  uint32_t head = ring->head;
+  int taken = 0;
+
+  __sync_synchronize();
+  for (; tail != head; tail++, taken++) {
+    creec_req_t *req = ring->slots[tail & (ring->size - 1)];
+    if (creec_enqueue(dev, req) < 0)
+      req->status = CREEC_REQ_FREE;
+  }
+  // finish reading the slots before handing them back to the producer
+  __sync_synchronize();
+  ring->tail = tail;
+  return taken;
+}
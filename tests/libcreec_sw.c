@@ -0,0 +1,570 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "libcreec.h"
+#include "trace.h"
+
+// Software model of the CREECelerator pipelines, bit exact with the
+// hardware: differential + run-length coding (CompressionUtils), zero padding
+// to the AES block size, AES-128 with HWKey and RS(16,8) over GF(2^8)
+// (RSParams.RS16_8_8). The lookup tables are built once by creec_sw_init().
+
+typedef uint64_t __attribute__((may_alias)) creec_sw_word_t;
+
+#define AES_BLOCK_BYTES   16
+#define AES_ROUNDS        10
+#define RS_N              16
+#define RS_K              8
+
+static const uint8_t creec_sw_key[AES_BLOCK_BYTES] =
+  { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 3, 2 };
+
+static int creec_sw_ready;
+
+// AES: S-boxes, one T-table per direction (the other three columns are
+// rotations of it) and both key schedules as big-endian column words
+static uint8_t aes_sbox[256];
+static uint8_t aes_inv_sbox[256];
+static uint32_t aes_te[256];
+static uint32_t aes_td[256];
+static uint32_t aes_ek[4 * (AES_ROUNDS + 1)];
+static uint32_t aes_dk[4 * (AES_ROUNDS + 1)];
+
+// RS: GF(2^8) with primitive polynomial 0x11D and alpha = 2
+static uint8_t rs_exp[512];
+static uint8_t rs_log[256];
+// rs_par[f]: byte j is f * g_j, the parity LFSR update for feedback f
+static uint64_t rs_par[256];
+
+// Largest intermediate the read path keeps: one pipeline's worth of beats
+static uint8_t creec_sw_buf[CREECR_MAX_BEATS * BYTES_PER_BEAT]
+  __attribute__((aligned(8)));
+
+static uint32_t ror8(uint32_t x) {
+  return (x >> 8) | (x << 24);
+}
+
+static uint8_t aes_xtime(uint8_t x) {
+  return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1B : 0));
+}
+
+static uint8_t aes_mul(uint8_t a, uint8_t b) {
+  uint8_t p = 0;
+
+  while (b) {
+    if (b & 1)
+      p ^= a;
+    a = aes_xtime(a);
+    b >>= 1;
+  }
+  return p;
+}
+
+static uint32_t aes_load32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void aes_store32(uint8_t *p, uint32_t x) {
+  p[0] = (uint8_t)(x >> 24);
+  p[1] = (uint8_t)(x >> 16);
+  p[2] = (uint8_t)(x >> 8);
+  p[3] = (uint8_t)x;
+}
+
+static uint32_t aes_sub_word(uint32_t x) {
+  return ((uint32_t)aes_sbox[x >> 24] << 24) |
+         ((uint32_t)aes_sbox[(x >> 16) & 0xFF] << 16) |
+         ((uint32_t)aes_sbox[(x >> 8) & 0xFF] << 8) |
+         aes_sbox[x & 0xFF];
+}
+
+// InvMixColumns of one column, for the equivalent inverse cipher key schedule
+static uint32_t aes_inv_mix(uint32_t x) {
+  return aes_td[aes_sbox[x >> 24]] ^
+         ror8(aes_td[aes_sbox[(x >> 16) & 0xFF]]) ^
+         ror8(ror8(aes_td[aes_sbox[(x >> 8) & 0xFF]])) ^
+         ror8(ror8(ror8(aes_td[aes_sbox[x & 0xFF]])));
+}
+
+static void aes_init(void) {
+  uint8_t pow[256], lg[256];
+  uint8_t x = 1, rcon = 1;
+  int i;
+
+  // 3 generates the multiplicative group of GF(2^8) mod 0x11B
+  for (i = 0; i < 255; i++) {
+    pow[i] = x;
+    lg[x] = (uint8_t)i;
+    x ^= aes_xtime(x);
+  }
+  for (i = 0; i < 256; i++) {
+    uint8_t inv = i ? pow[(255 - lg[i]) % 255] : 0;
+    uint8_t s = inv ^ (uint8_t)((inv << 1) | (inv >> 7)) ^
+                (uint8_t)((inv << 2) | (inv >> 6)) ^
+                (uint8_t)((inv << 3) | (inv >> 5)) ^
+                (uint8_t)((inv << 4) | (inv >> 4)) ^ 0x63;
+    aes_sbox[i] = s;
+    aes_inv_sbox[s] = (uint8_t)i;
+  }
+  for (i = 0; i < 256; i++) {
+    uint8_t s = aes_sbox[i], t = aes_inv_sbox[i];
+    aes_te[i] = ((uint32_t)aes_mul(s, 2) << 24) | ((uint32_t)s << 16) |
+                ((uint32_t)s << 8) | aes_mul(s, 3);
+    aes_td[i] = ((uint32_t)aes_mul(t, 14) << 24) | ((uint32_t)aes_mul(t, 9) << 16) |
+                ((uint32_t)aes_mul(t, 13) << 8) | aes_mul(t, 11);
+  }
+
+  for (i = 0; i < 4; i++)
+    aes_ek[i] = aes_load32(creec_sw_key + 4 * i);
+  for (i = 4; i < 4 * (AES_ROUNDS + 1); i++) {
+    uint32_t w = aes_ek[i - 1];
+    if (i % 4 == 0) {
+      w = aes_sub_word((w << 8) | (w >> 24)) ^ ((uint32_t)rcon << 24);
+      rcon = aes_xtime(rcon);
+    }
+    aes_ek[i] = aes_ek[i - 4] ^ w;
+  }
+
+  // Decryption round keys in reverse order, with InvMixColumns applied to
+  // the inner ones so both directions share the same round structure
+  for (i = 0; i <= AES_ROUNDS; i++) {
+    int j;
+    for (j = 0; j < 4; j++) {
+      uint32_t w = aes_ek[4 * (AES_ROUNDS - i) + j];
+      aes_dk[4 * i + j] = (i == 0 || i == AES_ROUNDS) ? w : aes_inv_mix(w);
+    }
+  }
+}
+
+#define AES_TE(a, b, c, d) \
+  (aes_te[(a) >> 24] ^ ror8(aes_te[((b) >> 16) & 0xFF]) ^ \
+   ror8(ror8(aes_te[((c) >> 8) & 0xFF])) ^ ror8(ror8(ror8(aes_te[(d) & 0xFF]))))
+#define AES_TD(a, b, c, d) \
+  (aes_td[(a) >> 24] ^ ror8(aes_td[((b) >> 16) & 0xFF]) ^ \
+   ror8(ror8(aes_td[((c) >> 8) & 0xFF])) ^ ror8(ror8(ror8(aes_td[(d) & 0xFF]))))
+#define AES_SB(s, a, b, c, d) \
+  (((uint32_t)s[(a) >> 24] << 24) | ((uint32_t)s[((b) >> 16) & 0xFF] << 16) | \
+   ((uint32_t)s[((c) >> 8) & 0xFF] << 8) | s[(d) & 0xFF])
+
+static void aes_encrypt(uint8_t *blk) {
+  const uint32_t *rk = aes_ek;
+  uint32_t s0 = aes_load32(blk) ^ rk[0];
+  uint32_t s1 = aes_load32(blk + 4) ^ rk[1];
+  uint32_t s2 = aes_load32(blk + 8) ^ rk[2];
+  uint32_t s3 = aes_load32(blk + 12) ^ rk[3];
+  int r;
+
+  for (r = 1; r < AES_ROUNDS; r++) {
+    uint32_t t0, t1, t2, t3;
+    rk += 4;
+    t0 = AES_TE(s0, s1, s2, s3) ^ rk[0];
+    t1 = AES_TE(s1, s2, s3, s0) ^ rk[1];
+    t2 = AES_TE(s2, s3, s0, s1) ^ rk[2];
+    t3 = AES_TE(s3, s0, s1, s2) ^ rk[3];
+    s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+  }
+  rk += 4;
+  aes_store32(blk, AES_SB(aes_sbox, s0, s1, s2, s3) ^ rk[0]);
+  aes_store32(blk + 4, AES_SB(aes_sbox, s1, s2, s3, s0) ^ rk[1]);
+  aes_store32(blk + 8, AES_SB(aes_sbox, s2, s3, s0, s1) ^ rk[2]);
+  aes_store32(blk + 12, AES_SB(aes_sbox, s3, s0, s1, s2) ^ rk[3]);
+}
+
+static void aes_decrypt(uint8_t *blk) {
+  const uint32_t *rk = aes_dk;
+  uint32_t s0 = aes_load32(blk) ^ rk[0];
+  uint32_t s1 = aes_load32(blk + 4) ^ rk[1];
+  uint32_t s2 = aes_load32(blk + 8) ^ rk[2];
+  uint32_t s3 = aes_load32(blk + 12) ^ rk[3];
+  int r;
+
+  for (r = 1; r < AES_ROUNDS; r++) {
+    uint32_t t0, t1, t2, t3;
+    rk += 4;
+    t0 = AES_TD(s0, s3, s2, s1) ^ rk[0];
+    t1 = AES_TD(s1, s0, s3, s2) ^ rk[1];
+    t2 = AES_TD(s2, s1, s0, s3) ^ rk[2];
+    t3 = AES_TD(s3, s2, s1, s0) ^ rk[3];
+    s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+  }
+  rk += 4;
+  aes_store32(blk, AES_SB(aes_inv_sbox, s0, s3, s2, s1) ^ rk[0]);
+  aes_store32(blk + 4, AES_SB(aes_inv_sbox, s1, s0, s3, s2) ^ rk[1]);
+  aes_store32(blk + 8, AES_SB(aes_inv_sbox, s2, s1, s0, s3) ^ rk[2]);
+  aes_store32(blk + 12, AES_SB(aes_inv_sbox, s3, s2, s1, s0) ^ rk[3]);
+}
+
+static uint8_t rs_mul(uint8_t a, uint8_t b) {
+  return (a && b) ? rs_exp[rs_log[a] + rs_log[b]] : 0;
+}
+
+static uint8_t rs_div(uint8_t a, uint8_t b) {
+  return a ? rs_exp[rs_log[a] + 255 - rs_log[b]] : 0;
+}
+
+static void rs_init(void) {
+  uint8_t g[RS_N - RS_K + 1] = { 1 };
+  uint32_t x = 1;
+  int i, j;
+
+  for (i = 0; i < 255; i++) {
+    rs_exp[i] = rs_exp[i + 255] = (uint8_t)x;
+    rs_log[x] = (uint8_t)i;
+    x <<= 1;
+    if (x & 0x100)
+      x ^= 0x11D;
+  }
+
+  // g(X) = (X + alpha^0)(X + alpha^1)...(X + alpha^7), low order first
+  for (i = 0; i < RS_N - RS_K; i++) {
+    for (j = i + 1; j > 0; j--)
+      g[j] = g[j - 1] ^ rs_mul(g[j], rs_exp[i]);
+    g[0] = rs_mul(g[0], rs_exp[i]);
+  }
+  for (i = 0; i < 256; i++) {
+    uint64_t p = 0;
+    for (j = 0; j < RS_N - RS_K; j++)
+      p |= (uint64_t)rs_mul((uint8_t)i, g[j]) << (8 * j);
+    rs_par[i] = p;
+  }
+}
+
+void creec_sw_init(void) {
+  if (creec_sw_ready)
+    return;
+  aes_init();
+  rs_init();
+  creec_sw_ready = 1;
+}
+
+// Bytewise (SIMD within a register) add and subtract of eight lanes
+#define SWAR_H 0x8080808080808080ULL
+
+static uint64_t swar_add(uint64_t a, uint64_t b) {
+  return ((a & ~SWAR_H) + (b & ~SWAR_H)) ^ ((a ^ b) & SWAR_H);
+}
+
+static uint64_t swar_sub(uint64_t a, uint64_t b) {
+  return ((a | SWAR_H) - (b & ~SWAR_H)) ^ ((a ^ ~b) & SWAR_H);
+}
+
+static int swar_has_zero(uint64_t x) {
+  return ((x - 0x0101010101010101ULL) & ~x & SWAR_H) != 0;
+}
+
+// out[i] = in[i] - in[i - 1], starting from 0, eight bytes per step.
+// n is a multiple of 8.
+static void creec_sw_delta(uint8_t *dst, const uint8_t *src, uint32_t n) {
+  uint64_t prev = 0;
+  uint32_t i;
+
+  for (i = 0; i < n; i += 8) {
+    uint64_t w;
+    memcpy(&w, src + i, 8);
+    *(creec_sw_word_t *)(dst + i) = swar_sub(w, (w << 8) | (prev >> 56));
+    prev = w;
+  }
+}
+
+// Inverse of creec_sw_delta(): a running sum, done as a log-step prefix sum
+// within each word plus the carry from the previous one
+static void creec_sw_undelta(uint8_t *buf, uint32_t n) {
+  uint64_t carry = 0;
+  uint32_t i;
+
+  for (i = 0; i < n; i += 8) {
+    uint64_t w;
+    memcpy(&w, buf + i, 8);
+    w = swar_add(w, w << 8);
+    w = swar_add(w, w << 16);
+    w = swar_add(w, w << 32);
+    w = swar_add(w, carry);
+    memcpy(buf + i, &w, 8);
+    carry = (w >> 56) * 0x0101010101010101ULL;
+  }
+}
+
+// Run-length code the zeros of src: a run of k zeros becomes 0, k - 1, with
+// runs longer than 256 split. Words without a zero byte are copied whole.
+// Returns the output length, or -1 if it exceeds max.
+static int32_t creec_sw_rle(uint8_t *dst, uint32_t max, const uint8_t *src,
+                            uint32_t n) {
+  uint32_t i = 0, o = 0;
+
+  while (i < n) {
+    if (i + 8 <= n && o + 8 <= max) {
+      uint64_t w;
+      memcpy(&w, src + i, 8);
+      if (!swar_has_zero(w)) {
+        memcpy(dst + o, &w, 8);
+        i += 8;
+        o += 8;
+        continue;
+      }
+    }
+    if (src[i]) {
+      if (o >= max)
+        return -1;
+      dst[o++] = src[i++];
+    } else {
+      uint32_t run = 0;
+      while (i < n && !src[i] && run < 256) {
+        i++;
+        run++;
+      }
+      if (o + 2 > max)
+        return -1;
+      dst[o++] = 0;
+      dst[o++] = (uint8_t)(run - 1);
+    }
+  }
+  return (int32_t)o;
+}
+
+// Inverse of creec_sw_rle(). A dangling 0 at the end of the input decodes
+// to a single zero. Returns the output length, or -1 if it exceeds max.
+static int32_t creec_sw_unrle(uint8_t *dst, uint32_t max, const uint8_t *src,
+                              uint32_t n) {
+  uint32_t i = 0, o = 0;
+
+  while (i < n) {
+    if (src[i]) {
+      if (o >= max)
+        return -1;
+      dst[o++] = src[i++];
+    } else {
+      uint32_t run = (i + 1 < n) ? src[i + 1] + 1u : 1;
+      if (o + run > max)
+        return -1;
+      memset(dst + o, 0, run);
+      o += run;
+      i += 2;
+    }
+  }
+  return (int32_t)o;
+}
+
+// Encode one 8-byte group into a 16-byte codeword: the message followed by
+// the parity symbols, highest order first. The parity register is a single
+// 64-bit word, one symbol per byte.
+// cw may overlap msg.
+static void rs_encode(uint8_t *cw, const uint8_t *msg) {
+  uint8_t m[RS_K];
+  uint64_t par = 0;
+  int i;
+
+  memcpy(m, msg, RS_K);
+  for (i = 0; i < RS_K; i++)
+    par = (par << 8) ^ rs_par[m[i] ^ (uint8_t)(par >> 56)];
+  memcpy(cw, m, RS_K);
+  for (i = 0; i < RS_N - RS_K; i++)
+    cw[RS_K + i] = (uint8_t)(par >> (8 * (RS_N - RS_K - 1 - i)));
+}
+
+// Correct up to four symbol errors of a codeword in place (cw[0] is the
+// coefficient of X^15) with Berlekamp-Massey, Chien search and Forney.
+// Words that cannot be corrected are left as they are, like the hardware
+// decoder which has no failure output.
+static void rs_decode(uint8_t *cw) {
+  const int np = RS_N - RS_K;
+  uint8_t s[RS_N - RS_K], lam[RS_N - RS_K + 1] = { 1 }, b[RS_N - RS_K + 1] = { 1 };
+  uint8_t omega[RS_N - RS_K], fix[RS_N];
+  int i, j, k, l = 0, any = 0, nfix = 0;
+
+  for (i = 0; i < np; i++) {
+    uint8_t acc = 0;
+    for (j = 0; j < RS_N; j++)
+      acc = rs_mul(acc, rs_exp[i]) ^ cw[j];
+    s[i] = acc;
+    any |= acc;
+  }
+  if (!any)
+    return;
+
+  for (k = 0; k < np; k++) {
+    uint8_t d = s[k], t[RS_N - RS_K + 1];
+    for (i = 1; i <= l; i++)
+      d ^= rs_mul(lam[i], s[k - i]);
+    for (i = np; i > 0; i--)
+      b[i] = b[i - 1];
+    b[0] = 0;
+    if (d) {
+      memcpy(t, lam, sizeof(t));
+      for (i = 0; i <= np; i++)
+        lam[i] ^= rs_mul(d, b[i]);
+      if (2 * l <= k) {
+        l = k + 1 - l;
+        for (i = 0; i <= np; i++)
+          b[i] = rs_div(t[i], d);
+      }
+    }
+  }
+
+  for (i = 0; i < np; i++) {
+    uint8_t acc = 0;
+    for (j = 0; j <= i; j++)
+      acc ^= rs_mul(lam[j], s[i - j]);
+    omega[i] = acc;
+  }
+
+  // Chien search over the 16 positions: X^p is in error if
+  // lam(alpha^-p) == 0
+  for (k = 0; k < RS_N; k++) {
+    int p = RS_N - 1 - k;
+    uint8_t xinv = rs_exp[(255 - p) % 255], v = 0, num = 0, den = 0, xi = 1;
+    for (i = 0; i <= l; i++) {
+      v ^= rs_mul(lam[i], xi);
+      xi = rs_mul(xi, xinv);
+    }
+    if (v)
+      continue;
+    // Forney, first consecutive root alpha^0:
+    // e = X * omega(X^-1) / lam'(X^-1)
+    xi = 1;
+    for (i = 0; i < np; i++) {
+      num ^= rs_mul(omega[i], xi);
+      xi = rs_mul(xi, xinv);
+    }
+    xi = 1;
+    for (i = 1; i <= l; i += 2) {
+      den ^= rs_mul(lam[i], xi);
+      xi = rs_mul(xi, rs_mul(xinv, xinv));
+    }
+    if (!den)
+      return;
+    fix[nfix++] = (uint8_t)k;
+    fix[nfix++] = rs_mul(rs_exp[p], rs_div(num, den));
+  }
+  if (nfix / 2 != l)
+    return;
+  for (i = 0; i < nfix; i += 2)
+    cw[fix[i]] ^= fix[i + 1];
+}
+
+int creec_sw_write(const creec_header_t *in, const uint8_t *src,
+                   uint8_t *dst, uint32_t dst_bytes, creec_header_t *out) {
+  uint32_t n = in->len * BYTES_PER_BEAT;
+  uint32_t max = dst_bytes / 2;
+  uint32_t cpad, epad, i;
+  int32_t c;
+
+  creec_sw_init();
+
+  // Compress into the first half of dst, leaving room for the parity
+  // symbols the ECC stage adds to every 8 bytes
+  if (n > sizeof(creec_sw_buf))
+    return -1;
+  creec_sw_delta(creec_sw_buf, src, n);
+  c = creec_sw_rle(dst, max, creec_sw_buf, n);
+  if (c < 0)
+    return -1;
+
+  cpad = (BYTES_PER_BEAT - c % BYTES_PER_BEAT) % BYTES_PER_BEAT;
+  epad = (AES_BLOCK_BYTES - (c + cpad) % AES_BLOCK_BYTES) % AES_BLOCK_BYTES;
+  if (c + cpad + epad > max)
+    return -1;
+  memset(dst + c, 0, cpad + epad);
+  n = c + cpad + epad;
+
+  for (i = 0; i < n; i += AES_BLOCK_BYTES)
+    aes_encrypt(dst + i);
+
+  // Expand back to front so no group is overwritten before it is encoded
+  for (i = n; i > 0; i -= RS_K)
+    rs_encode(dst + 2 * (i - RS_K), dst + i - RS_K);
+
+  out->len = 2 * n / BYTES_PER_BEAT;
+  out->addr = in->addr;
+  out->compressed = 1;
+  out->encrypted = 1;
+  out->ecc = 1;
+  out->compressed_pad_bytes = cpad;
+  out->encrypted_pad_bytes = epad;
+  out->ecc_pad_bytes = 0;
+  return 0;
+}
+
+int creec_sw_read(const creec_header_t *in, const uint8_t *src,
+                  uint8_t *dst, uint32_t dst_bytes, creec_header_t *out) {
+  uint32_t n = in->len * BYTES_PER_BEAT;
+  uint8_t *buf = creec_sw_buf;
+  int32_t d;
+  uint32_t i;
+
+  creec_sw_init();
+
+  if (n % RS_N || n > 2 * sizeof(creec_sw_buf))
+    return -1;
+  for (i = 0; i < n; i += RS_N) {
+    uint8_t cw[RS_N];
+    memcpy(cw, src + i, RS_N);
+    rs_decode(cw);
+    memcpy(buf + i / 2, cw, RS_K);
+  }
+  n /= 2;
+
+  for (i = 0; i + AES_BLOCK_BYTES <= n; i += AES_BLOCK_BYTES)
+    aes_decrypt(buf + i);
+
+  if (in->encrypted_pad_bytes + in->compressed_pad_bytes > n)
+    return -1;
+  n -= in->encrypted_pad_bytes + in->compressed_pad_bytes;
+  d = creec_sw_unrle(dst, dst_bytes, buf, n);
+  if (d < 0)
+    return -1;
+
+  // The decompressor emits whole beats; the tail of the last one is zero
+  n = (d + BYTES_PER_BEAT - 1) / BYTES_PER_BEAT * BYTES_PER_BEAT;
+  if (n > dst_bytes)
+    return -1;
+  creec_sw_undelta(dst, n);
+  memset(dst + d, 0, n - d);
+
+  memset(out, 0, sizeof(*out));
+  out->len = n / BYTES_PER_BEAT;
+  out->addr = in->addr;
+  return 0;
+}
+
+// Requests queued or running on dev
+static uint32_t creec_occupancy(const creec_dev_t *dev) {
+  const creec_req_t *req;
+  uint32_t n = 0;
+
+  for (req = dev->head; req; req = req->next)
+    n++;
+  return n;
+}
+
+int creec_submit_hybrid(creec_dev_t *dev, creec_req_t *req,
+                        uint32_t max_queued) {
+  int r;
+
+  if (req->status == CREEC_REQ_QUEUED || req->status == CREEC_REQ_RUNNING)
+    return -1;
+  if (req->header_in.len == 0 || req->header_in.len > dev->max_beats)
+    return -1;
+  if (req->src_iov || req->dst_iov || creec_occupancy(dev) < max_queued)
+    return creec_submit(dev, req);
+
+  trace(TRACE_CREEC_SW, dev->ctrl >> 8, req->header_in.len);
+  if (dev->ctrl == CREECW_ENABLE)
+    r = creec_sw_write(&req->header_in, req->src, req->dst, req->dst_bytes,
+                       &req->header_out);
+  else
+    r = creec_sw_read(&req->header_in, req->src, req->dst, req->dst_bytes,
+                      &req->header_out);
+  if (r < 0)
+    return creec_submit(dev, req);
+
+  req->next = NULL;
+  req->out_bytes = req->header_out.len * BYTES_PER_BEAT;
+  dev->sw_reqs++;
+  __sync_synchronize();
+  req->status = CREEC_REQ_DONE;
+  trace(TRACE_CREEC_DONE, dev->ctrl >> 8, req->status);
+  if (req->complete)
+    req->complete(req);
+  return 1;
+}
@@ -0,0 +1,31 @@
+#ifndef __PLIC_H__
+#define __PLIC_H__
+
+#include <stdint.h>
+
+#include "mmio.h"
+
+// Rocket-chip PLIC, hart 0 machine-mode context
+#define PLIC_BASE               0x0c000000
+#define PLIC_PRIORITY(id)       (PLIC_BASE + 4 * (id))
+#define PLIC_ENABLE(id)         (PLIC_BASE + 0x2000 + 4 * ((id) / 32))
+#define PLIC_THRESHOLD          (PLIC_BASE + 0x200000)
+#define PLIC_CLAIM              (PLIC_BASE + 0x200004)
+
+static inline void plic_enable(uint32_t id, uint32_t priority)
+{
+	reg_write32(PLIC_PRIORITY(id), priority);
+	reg_write32(PLIC_ENABLE(id), reg_read32(PLIC_ENABLE(id)) | (1 << (id % 32)));
+}
+
+static inline uint32_t plic_claim(void)
+{
+	return reg_read32(PLIC_CLAIM);
+}
+
+static inline void plic_complete(uint32_t id)
+{
+	reg_write32(PLIC_CLAIM, id);
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include <limits.h>
 #include <sys/signal.h>
 #include "util.h"
+#include "trace.h"
 
 #define SYS_write 64
 
@@ -66,6 +67,7 @@ uintptr_t __attribute__((weak)) handle_trap(uintptr_t cause, uintptr_t epc, uint
 
 void exit(int code)
 {
+  trace_dump();
   tohost_exit(code);
 }
 
@@ -0,0 +1,73 @@
+#include <stdint.h>
+
+#include "trace.h"
+
+extern void printstr(const char *s);
+
+trace_ring_t trace_rings[NCORES];
+
+// Events per output line, and lines per printstr() call: one HTIF round
+// trip per chunk instead of one per 64 characters through putchar()
+#define TRACE_PER_LINE   4
+#define TRACE_LINES      32
+
+static char *trace_hex(char *p, uint64_t x, int digits) {
+  int i;
+
+  for (i = digits - 1; i >= 0; i--) {
+    uint32_t d = x & 0xF;
+    p[i] = d < 10 ? '0' + d : 'a' + d - 10;
+    x >>= 4;
+  }
+  return p + digits;
+}
+
+static char *trace_str(char *p, const char *s) {
+  while (*s)
+    *p++ = *s++;
+  return p;
+}
+
+// Block format, read by trace_decode.py:
+//   #trace <hart> <events> <dropped>
+//   <event> <event> <event> <event>
+//   ...
+//   #end
+// with all numbers in hex and events oldest first.
+static void trace_dump_ring(uint32_t hart, trace_ring_t *ring) {
+  static char buf[TRACE_LINES * TRACE_PER_LINE * 17 + 64];
+  uint64_t n = ring->pos < TRACE_ENTRIES ? ring->pos : TRACE_ENTRIES;
+  uint64_t i;
+  char *p = buf;
+
+  p = trace_str(p, "#trace ");
+  p = trace_hex(p, hart, 2);
+  *p++ = ' ';
+  p = trace_hex(p, n, 8);
+  *p++ = ' ';
+  p = trace_hex(p, ring->pos - n, 16);
+  *p++ = '\n';
+
+  for (i = 0; i < n; i++) {
+    p = trace_hex(p, ring->buf[(ring->pos - n + i) & (TRACE_ENTRIES - 1)], 16);
+    *p++ = (i % TRACE_PER_LINE == TRACE_PER_LINE - 1 || i == n - 1) ? '\n' : ' ';
+    if (p - buf >= (TRACE_LINES * TRACE_PER_LINE - 1) * 17) {
+      *p = 0;
+      printstr(buf);
+      p = buf;
+    }
+  }
+  p = trace_str(p, "#end\n");
+  *p = 0;
+  printstr(buf);
+  ring->pos = 0;
+}
+
+void trace_dump(void) {
+  uint32_t hart;
+
+  for (hart = 0; hart < NCORES; hart++) {
+    if (trace_rings[hart].pos)
+      trace_dump_ring(hart, &trace_rings[hart]);
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdint.h>
+
+#include "encoding.h"
+
+// Binary event tracing. Each event is one 64-bit word, written with a single
+// store into a per-hart ring that keeps the last TRACE_ENTRIES events:
+//
+//   63          32 31    24 23      12 11       0
+//   | mcycle[31:0] |   id   |   arg0   |   arg1   |
+//
+// Arguments are truncated to 12 bits; the cycle count wraps every 2^32
+// cycles and is unwrapped by the decoder. trace_dump() prints the rings as
+// hex in bulk, and is called by exit() whenever an event was recorded; pipe
+// the simulator output through trace_decode.py to read them.
+//
+// trace() compiles to nothing unless TRACE is defined (make TRACE=1).
+
+#ifndef NCORES
+# define NCORES 1
+#endif
+
+#ifndef TRACE_ENTRIES_LOG2
+# define TRACE_ENTRIES_LOG2 10
+#endif
+#define TRACE_ENTRIES (1 << TRACE_ENTRIES_LOG2)
+
+// Event ids below 0x80 are reserved for libraries, the rest for programs
+#define TRACE_CREEC_SUBMIT    0x01  // arg0: ctrl >> 8, arg1: len
+#define TRACE_CREEC_START     0x02  // arg0: ctrl >> 8, arg1: len
+#define TRACE_CREEC_HEADER    0x03  // arg0: ctrl >> 8, arg1: output len
+#define TRACE_CREEC_DRAIN     0x04  // arg0: ctrl >> 8, arg1: beats
+#define TRACE_CREEC_DONE      0x05  // arg0: ctrl >> 8, arg1: status
+#define TRACE_CREEC_IRQ       0x06  // arg0: PLIC source
+#define TRACE_CREEC_SW        0x07  // arg0: ctrl >> 8, arg1: len
+#define TRACE_USER            0x80
+
+typedef struct {
+  uint64_t buf[TRACE_ENTRIES];
+  uint64_t pos;              // events recorded since the last dump
+} __attribute__((aligned(64))) trace_ring_t;
+
+extern trace_ring_t trace_rings[NCORES];
+
+static inline void trace_record(uint32_t id, uint32_t arg0, uint32_t arg1) {
+  trace_ring_t *ring = &trace_rings[NCORES > 1 ? read_csr(mhartid) : 0];
+  uint64_t cycle = read_csr(mcycle);
+
+  ring->buf[ring->pos++ & (TRACE_ENTRIES - 1)] =
+    (cycle << 32) | ((id & 0xFF) << 24) | ((arg0 & 0xFFF) << 12) |
+    (arg1 & 0xFFF);
+}
+
+#ifdef TRACE
+# define trace(id, arg0, arg1) trace_record((id), (arg0), (arg1))
+#else
+# define trace(id, arg0, arg1) ((void)0)
+#endif
+
+// Print every ring that holds events and empty them. Harts other than the
+// caller must not be recording at the same time.
+void trace_dump(void);
+
+#endif //__TRACE_H
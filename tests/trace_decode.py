@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Decode the event rings printed by trace_dump() (tests/trace.h).
+
+Reads simulator output from the given files, or stdin, skips everything that
+is not a trace block and prints one event per line, with the 32-bit cycle
+stamps unwrapped into absolute cycles.
+
+  ./simulator-... ../tests/creec.riscv | ../tests/trace_decode.py
+  ../tests/trace_decode.py --summary run.log
+"""
+
+import argparse
+import sys
+
+NAMES = {
+    0x01: "creec_submit",
+    0x02: "creec_start",
+    0x03: "creec_header",
+    0x04: "creec_drain",
+    0x05: "creec_done",
+    0x06: "creec_irq",
+    0x07: "creec_sw",
+}
+TRACE_USER = 0x80
+
+
+def name(event_id):
+    if event_id >= TRACE_USER:
+        return "user+%d" % (event_id - TRACE_USER)
+    return NAMES.get(event_id, "id%d" % event_id)
+
+
+def blocks(lines):
+    """Yield (hart, dropped, [event words]) for every trace block."""
+    block = None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("#trace "):
+            _, hart, _, dropped = line.split()
+            block = (int(hart, 16), int(dropped, 16), [])
+        elif line == "#end" and block is not None:
+            yield block
+            block = None
+        elif block is not None:
+            block[2].extend(int(word, 16) for word in line.split())
+
+
+def decode(words):
+    """Yield (cycle, id, arg0, arg1) with cycles unwrapped."""
+    cycle = None
+    for word in words:
+        low = word >> 32
+        if cycle is None:
+            cycle = low
+        else:
+            cycle += (low - cycle) & 0xFFFFFFFF
+        yield cycle, (word >> 24) & 0xFF, (word >> 12) & 0xFFF, word & 0xFFF
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("files", nargs="*", help="simulator output (default: stdin)")
+    parser.add_argument("--summary", action="store_true",
+                        help="print per-event counts and the cycles since the "
+                             "previous event instead of the events")
+    args = parser.parse_args()
+
+    files = [open(f) for f in args.files] or [sys.stdin]
+    stats = {}
+    for f in files:
+        for hart, dropped, words in blocks(f):
+            if not args.summary:
+                print("# hart %d: %d events, %d older ones dropped"
+                      % (hart, len(words), dropped))
+                print("%5s %14s %10s  %-14s %5s %5s"
+                      % ("hart", "cycle", "delta", "event", "arg0", "arg1"))
+            prev = None
+            for cycle, event_id, arg0, arg1 in decode(words):
+                delta = cycle - prev if prev is not None else 0
+                prev = cycle
+                if args.summary:
+                    s = stats.setdefault(event_id, [0, 0, None, 0])
+                    s[0] += 1
+                    s[1] += delta
+                    s[2] = delta if s[2] is None else min(s[2], delta)
+                    s[3] = max(s[3], delta)
+                else:
+                    print("%5d %14d %10d  %-14s %5d %5d"
+                          % (hart, cycle, delta, name(event_id), arg0, arg1))
+
+    if args.summary:
+        print("%-14s %8s %10s %10s %10s" % ("event", "count", "delta_avg",
+                                            "delta_min", "delta_max"))
+        for event_id in sorted(stats):
+            count, total, lo, hi = stats[event_id]
+            print("%-14s %8d %10d %10d %10d"
+                  % (name(event_id), count, total // count, lo, hi))
+
+
+if __name__ == "__main__":
+    main()
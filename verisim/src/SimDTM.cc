@@ -0,0 +1,168 @@
+// See LICENSE.SiFive for license details.
+
+#include <cstdlib>
+#include <functional>
+#include <fesvr/dtm.h>
+#include "sim_stats.h"
+#ifdef VERILATOR_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+extern double sc_time_stamp();
+
+// Set by the emulator while the DTM must leave the debug module alone, e.g.
+// until a checkpoint of the booted design has been taken, during a batch
+// run's reset, before the DTM exists, or for cycles the emulator has already
+// ticked the DTM for while fast-forwarding. The DMI port is kept idle and the
+// DTM is not ticked.
+bool dtm_hold;
+
+// A DMI request has been taken by the debug module and its response has not
+// arrived yet
+bool dtm_busy;
+
+// Cycles between ticks of an idle DTM, i.e. one with no request out and no
+// response due (--host-interval)
+unsigned host_interval = 1;
+
+dtm_t* dtm;
+
+#ifdef VERILATOR_THREADS
+// fesvr switches between the DTM and its host code with user-level contexts,
+// which only work on the OS thread that created the DTM. The multithreaded
+// model may call debug_tick() from any of its evaluation threads, so there
+// the DTM is created, ticked and deleted by a thread of its own, which the
+// caller hands its work to and waits on.
+class dtm_thread_t
+{
+ public:
+  dtm_thread_t() : job(NULL), stop(false), thread(&dtm_thread_t::run, this) {}
+  ~dtm_thread_t()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cond.notify_all();
+    thread.join();
+  }
+
+  void call(const std::function<void()>& f)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    job = &f;
+    cond.notify_all();
+    cond.wait(lock, [&] { return job == NULL; });
+  }
+
+ private:
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cond.wait(lock, [&] { return job != NULL || stop; });
+      if (!job)
+        return;
+      (*job)();
+      job = NULL;
+      cond.notify_all();
+    }
+  }
+
+  const std::function<void()>* job;
+  bool stop;
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::thread thread;
+};
+#endif
+
+void dtm_call(const std::function<void()>& f)
+{
+#ifdef VERILATOR_THREADS
+  static dtm_thread_t thread;
+  thread.call(f);
+#else
+  f();
+#endif
+}
+extern "C" int debug_tick
+(
+  unsigned char* debug_req_valid,
+  unsigned char  debug_req_ready,
+  int*           debug_req_bits_addr,
+  int*           debug_req_bits_op,
+  int*           debug_req_bits_data,
+  unsigned char  debug_resp_valid,
+  unsigned char* debug_resp_ready,
+  int            debug_resp_bits_resp,
+  int            debug_resp_bits_data
+)
+{
+  // A request is taken when it was valid in the last cycle and the debug
+  // module is ready
+  static bool last_req_valid;
+
+  if (dtm_hold) {
+    *debug_req_valid = 0;
+    *debug_resp_ready = 1;
+    last_req_valid = false;
+    return 0;
+  }
+
+  if (!dtm)
+    abort();
+
+  static dtm_t::req stats_req;
+  double t = 0;
+  if (last_req_valid && debug_req_ready)
+    dtm_busy = true;
+  if (debug_resp_valid)
+    dtm_busy = false;
+  if (sim_stats) {
+    t = sim_now();
+    if (last_req_valid && debug_req_ready) {
+      sim_stats->dmi_reqs++;
+      sim_stats_dmi(sim_stats, stats_req.addr, stats_req.op, stats_req.data,
+                    sc_time_stamp());
+    }
+  }
+
+  // An idle DTM only polls its host thread, which may do so less often. A
+  // response from the debug module is always handled at once, which lets
+  // the host issue its next request right away.
+  bool idle = !last_req_valid && !dtm_busy && !debug_resp_valid;
+  if (!idle || host_interval <= 1 ||
+      (uint64_t)sc_time_stamp() % host_interval == 0) {
+    dtm_t::resp resp_bits;
+    resp_bits.resp = debug_resp_bits_resp;
+    resp_bits.data = debug_resp_bits_data;
+
+    // The DTM may have been ticked by the emulator while the request port
+    // was held idle, so it only counts as taken if it was actually presented
+    dtm_call([&] {
+      dtm->tick
+      (
+        debug_req_ready && last_req_valid,
+        debug_resp_valid,
+        resp_bits
+      );
+    });
+
+    last_req_valid = dtm->req_valid();
+    if (sim_stats) {
+      stats_req = dtm->req_bits();
+      sim_stats->dtm += sim_now() - t;
+    }
+  }
+
+  *debug_req_valid = dtm->req_valid();
+  *debug_req_bits_addr = dtm->req_bits().addr;
+  *debug_req_bits_op = dtm->req_bits().op;
+  *debug_req_bits_data = dtm->req_bits().data;
+  *debug_resp_ready = dtm->resp_ready();
+
+  return dtm->done() ? (dtm->exit_code() << 1 | 1) : 0;
+}
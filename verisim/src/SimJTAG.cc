@@ -2,6 +2,10 @@
 
 #include <cstdlib>
 #include "remote_bitbang.h"
+#include "sim_stats.h"
+
+extern double sc_time_stamp();
+extern unsigned host_interval;
 
 remote_bitbang_t* jtag;
 extern "C" int jtag_tick
@@ -18,7 +22,17 @@ extern "C" int jtag_tick
     jtag = new remote_bitbang_t(0);
   }
 
+  // With --host-interval the client is only serviced every host_interval
+  // cycles, and the pins keep their last values in between
+  if (host_interval > 1 && (uint64_t)sc_time_stamp() % host_interval) {
+    jtag->hold(jtag_TCK, jtag_TMS, jtag_TDI, jtag_TRSTn);
+    return jtag->done() ? (jtag->exit_code() << 1 | 1) : 0;
+  }
+
+  double t = sim_stats ? sim_now() : 0;
   jtag->tick(jtag_TCK, jtag_TMS, jtag_TDI, jtag_TRSTn, jtag_TDO);
+  if (sim_stats)
+    sim_stats->jtag += sim_now() - t;
 
   return jtag->done() ? (jtag->exit_code() << 1 | 1) : 0;
 
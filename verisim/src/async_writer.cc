@@ -0,0 +1,98 @@
+#include "async_writer.h"
+
+#include <string.h>
+#include <algorithm>
+
+async_writer_t::async_writer_t(FILE* file, size_t buf_bytes, size_t nbufs)
+  : file(file), buf_bytes(buf_bytes), bufs(nbufs), lens(nbufs, 0),
+    head(0), tail(0), stop(false), failed(false)
+{
+  for (std::vector<char>& buf : bufs)
+    buf.resize(buf_bytes);
+  thread = std::thread(&async_writer_t::run, this);
+}
+
+async_writer_t::~async_writer_t()
+{
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cond.notify_all();
+  thread.join();
+}
+
+// Hand the buffer being filled to the I/O thread and wait for the next one
+// to be free
+void async_writer_t::submit()
+{
+  size_t t = tail.load(std::memory_order_relaxed);
+  {
+    // The lock only orders the wakeup; the I/O thread reads tail without it
+    std::lock_guard<std::mutex> lock(mutex);
+    tail.store(t + 1, std::memory_order_release);
+  }
+  cond.notify_all();
+
+  if (t + 1 - head.load(std::memory_order_acquire) == bufs.size()) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&] {
+      return t + 1 - head.load(std::memory_order_acquire) < bufs.size();
+    });
+  }
+  lens[(t + 1) % bufs.size()] = 0;
+}
+
+bool async_writer_t::write(const char* bufp, size_t len)
+{
+  while (len) {
+    size_t i = tail.load(std::memory_order_relaxed) % bufs.size();
+    size_t n = std::min(len, buf_bytes - lens[i]);
+    memcpy(bufs[i].data() + lens[i], bufp, n);
+    lens[i] += n;
+    bufp += n;
+    len -= n;
+    if (lens[i] == buf_bytes)
+      submit();
+  }
+  return !failed.load(std::memory_order_relaxed);
+}
+
+bool async_writer_t::flush()
+{
+  size_t t = tail.load(std::memory_order_relaxed);
+  if (lens[t % bufs.size()]) {
+    submit();
+    t++;
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [&] { return head.load(std::memory_order_acquire) == t; });
+  if (fflush(file) != 0)
+    failed = true;
+  return !failed;
+}
+
+void async_writer_t::run()
+{
+  size_t h = 0;
+  while (true) {
+    if (tail.load(std::memory_order_acquire) == h) {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&] {
+        return stop || tail.load(std::memory_order_acquire) != h;
+      });
+      if (tail.load(std::memory_order_acquire) == h)
+        return;
+    }
+
+    size_t i = h % bufs.size();
+    if (!failed && fwrite(bufs[i].data(), 1, lens[i], file) != lens[i])
+      failed = true;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      head.store(++h, std::memory_order_release);
+    }
+    cond.notify_all();
+  }
+}
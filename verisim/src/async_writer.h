@@ -0,0 +1,49 @@
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Writes to a FILE from a background thread, so that the simulation thread
+// only copies trace text into memory instead of waiting on stdio and the
+// disk, or on the reader of a FIFO.
+//
+// Data is gathered in nbufs buffers of buf_bytes each, passed to the I/O
+// thread through a single-producer single-consumer ring of buffer indices.
+// Memory is bounded by the buffers: when all of them are waiting to be
+// written, write() blocks until the I/O thread frees one.
+class async_writer_t
+{
+ public:
+  async_writer_t(FILE* file, size_t buf_bytes = 4 << 20, size_t nbufs = 2);
+  // Writes out whatever is buffered
+  ~async_writer_t();
+
+  // False once a write to file has failed
+  bool write(const char* bufp, size_t len);
+  // Wait until everything written so far is in file
+  bool flush();
+
+ private:
+  void submit();
+  void run();
+
+  FILE* file;
+  size_t buf_bytes;
+  std::vector<std::vector<char> > bufs;
+  std::vector<size_t> lens;
+  // Buffers [head, tail) are full and owned by the I/O thread; buffer tail
+  // is being filled by write()
+  std::atomic<size_t> head, tail;
+  std::atomic<bool> stop, failed;
+  // Only used to sleep when the ring is empty (I/O thread) or full (write())
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::thread thread;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "batch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include "sim_stats.h"
+
+batch_result_t* batch_result;
+
+bool batch_read(const char* path, std::vector<batch_test_t>& tests)
+{
+  std::ifstream in(path);
+  if (!in)
+    return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream words(line);
+    batch_test_t test;
+    std::string word;
+    while (words >> word)
+      test.push_back(word);
+    if (!test.empty() && test[0][0] != '#')
+      tests.push_back(test);
+  }
+  return true;
+}
+
+static std::string test_name(const batch_test_t& test)
+{
+  std::string name;
+  for (const std::string& word : test)
+    name += (name.empty() ? "" : " ") + word;
+  return name;
+}
+
+// The index keeps apart tests of the same binary with different arguments
+static std::string log_path(const char* log_dir, const batch_test_t& test,
+                            size_t index)
+{
+  size_t slash = test[0].rfind('/');
+  std::string base = slash == std::string::npos ? test[0] : test[0].substr(slash + 1);
+  return std::string(log_dir) + "/" + std::to_string(index) + "-" + base + ".log";
+}
+
+int batch_run(const std::vector<batch_test_t>& tests, unsigned jobs,
+              const char* log_dir, int* status)
+{
+  size_t n = tests.size();
+  batch_result_t* results = (batch_result_t*) mmap(NULL,
+    n * sizeof(batch_result_t), PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (results == MAP_FAILED) {
+    perror("mmap");
+    *status = 1;
+    return -1;
+  }
+
+  double batch_start = sim_now();
+  std::vector<double> start(n), wall(n);
+  // -1 for a test that could not be started
+  std::vector<int> wstatus(n, -1);
+  std::map<pid_t, size_t> running;
+  size_t next = 0, finished = 0;
+
+  while (next < n || !running.empty()) {
+    if (next < n && running.size() < jobs) {
+      // Nothing buffered may be written twice
+      fflush(stdout);
+      fflush(stderr);
+      pid_t pid = fork();
+      if (pid == 0) {
+        if (log_dir) {
+          std::string log = log_path(log_dir, tests[next], next);
+          int fd = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+          if (fd < 0) {
+            perror(log.c_str());
+            _exit(1);
+          }
+          dup2(fd, 1);
+          dup2(fd, 2);
+          close(fd);
+        }
+        batch_result = &results[next];
+        return next;
+      }
+      if (pid < 0) {
+        perror("fork");
+        finished++;
+      } else {
+        start[next] = sim_now();
+        running[pid] = next;
+      }
+      next++;
+      continue;
+    }
+
+    int ws;
+    pid_t pid = waitpid(-1, &ws, 0);
+    if (pid < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("waitpid");
+      break;
+    }
+    std::map<pid_t, size_t>::iterator it = running.find(pid);
+    if (it == running.end())
+      continue;
+    size_t i = it->second;
+    running.erase(it);
+    wall[i] = sim_now() - start[i];
+    wstatus[i] = ws;
+    fprintf(stderr, "[%zu/%zu] %s\n", ++finished, n, test_name(tests[i]).c_str());
+  }
+
+  size_t passed = 0;
+  printf("%-8s %5s %12s %10s  %s\n", "result", "code", "cycles", "seconds", "test");
+  for (size_t i = 0; i < n; i++) {
+    const char* result = "error";
+    int code = -1;
+    if (wstatus[i] != -1 && WIFEXITED(wstatus[i])) {
+      code = WEXITSTATUS(wstatus[i]);
+      if (results[i].exit[0])
+        result = results[i].exit;
+    } else if (wstatus[i] != -1 && WIFSIGNALED(wstatus[i])) {
+      code = WTERMSIG(wstatus[i]);
+      result = "signal";
+    }
+    if (code == 0 && strcmp(result, "success") == 0)
+      passed++;
+    printf("%-8s %5d %12lu %10.2f  %s\n", result, code,
+           (unsigned long)results[i].cycles, wall[i], test_name(tests[i]).c_str());
+  }
+  printf("%zu of %zu tests passed in %.2f s\n", passed, n, sim_now() - batch_start);
+  fflush(stdout);
+
+  munmap(results, n * sizeof(batch_result_t));
+  *status = passed == n ? 0 : 1;
+  return -1;
+}
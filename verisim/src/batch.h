@@ -0,0 +1,37 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Runs a list of tests on one reset design. The emulator constructs and
+// resets the model once, then forks a worker per test, which inherits the
+// reset model and runs its test as a single run would. Up to jobs workers
+// run at a time, and their results are collected into one report.
+
+// One line of the list: a binary and its target arguments, separated by
+// whitespace. Blank lines and lines starting with '#' are skipped.
+typedef std::vector<std::string> batch_test_t;
+
+bool batch_read(const char* path, std::vector<batch_test_t>& tests);
+
+// Filled in by a worker before it exits, in memory shared with the parent
+struct batch_result_t
+{
+  uint64_t cycles;
+  char exit[16];  // exit reason, as in sim_stats_json()
+};
+
+// Set in a worker; NULL otherwise
+extern batch_result_t* batch_result;
+
+// Fork the workers. Returns the index of the test in each worker, whose
+// stdout and stderr go to log_dir/<index>-<binary name>.log if log_dir is
+// given, index counting the tests of the list from 0.
+// In the parent, returns -1 once all the tests have finished and the report
+// has been printed to stdout, with *status 0 if they all passed.
+int batch_run(const std::vector<batch_test_t>& tests, unsigned jobs,
+              const char* log_dir, int* status);
+
+#endif
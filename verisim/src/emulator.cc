@@ -6,8 +6,17 @@
 #include <memory>
 #include "verilated_vcd_c.h"
 #endif
+#ifdef VERILATOR_SAVABLE
+#include "verilated_save.h"
+#endif
+#ifdef VERILATOR_VPI
+#include "preload.h"
+#endif
 #include <fesvr/dtm.h>
 #include "remote_bitbang.h"
+#include "sim_stats.h"
+#include "fast_forward.h"
+#include "batch.h"
 #include <iostream>
 #include <fcntl.h>
 #include <signal.h>
@@ -15,6 +24,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <set>
+#include <vector>
 
 // For option parsing, which is split across this file, Verilog, and
 // FESVR's HTIF, a few external files must be pulled in. The list of
@@ -38,20 +54,273 @@ static uint64_t trace_count = 0;
 bool verbose;
 bool done_reset;
 
+// Long options without a short form
+enum {
+  OPT_SAVE_CHECKPOINT = 256,
+  OPT_RESTORE_CHECKPOINT,
+  OPT_CHECKPOINT_CYCLE,
+  OPT_PRELOAD,
+  OPT_PRELOAD_MEM,
+  OPT_PRELOAD_BASE,
+  OPT_DUMP_STOP,
+  OPT_DUMP_SCOPE,
+  OPT_DUMP_DEPTH,
+  OPT_FLIGHT_RECORDER,
+  OPT_STATS_JSON,
+  OPT_PROGRESS,
+  OPT_FAST_FORWARD,
+  OPT_RTC_PERIOD,
+  OPT_BATCH,
+  OPT_JOBS,
+  OPT_BATCH_LOGS,
+  OPT_HOST_INTERVAL,
+};
+
 void handle_sigterm(int sig)
 {
   dtm->stop();
 }
 
+static volatile sig_atomic_t stats_snapshot;
+
+void handle_sigusr1(int sig)
+{
+  stats_snapshot = 1;
+}
+
+static inline void eval(TEST_HARNESS* tile)
+{
+  if (!sim_stats) {
+    tile->eval();
+    return;
+  }
+  double t = sim_now();
+  tile->eval();
+  sim_stats->eval += sim_now() - t;
+}
+
+#if VM_TRACE
+static inline void dump_trace(VerilatedVcdC* tfp, vluint64_t time)
+{
+  if (!sim_stats) {
+    tfp->dump(time);
+    return;
+  }
+  double t = sim_now();
+  tfp->dump(time);
+  sim_stats->trace += sim_now() - t;
+}
+#endif
+
 double sc_time_stamp()
 {
   return trace_count;
 }
 
+#ifndef VERILATOR_VPI
 extern "C" int vpi_get_vlog_info(void* arg)
 {
   return 0;
 }
+#endif
+
+#ifdef VERILATOR_SAVABLE
+// A checkpoint is the emulator state followed by the Verilated model, as
+// written by Verilator's --savable support. The DTM is held off until the
+// checkpoint has been taken, so the debug module is idle and untouched in
+// it, and the restoring emulator's fresh DTM starts from the very state a
+// new one sees after reset.
+static const char checkpoint_magic[16] = "creec-ckpt-v1";
+
+static bool save_checkpoint(const char* path, TEST_HARNESS* tile)
+{
+  VerilatedSave os;
+  os.open(path);
+  if (!os.isOpen())
+    return false;
+  os.write(checkpoint_magic, sizeof(checkpoint_magic));
+  os << trace_count;
+  os << *tile;
+  os.close();
+  return true;
+}
+
+static bool restore_checkpoint(const char* path, TEST_HARNESS* tile)
+{
+  char magic[sizeof(checkpoint_magic)];
+  VerilatedRestore os;
+  os.open(path);
+  if (!os.isOpen())
+    return false;
+  os.read(magic, sizeof(magic));
+  if (memcmp(magic, checkpoint_magic, sizeof(magic)) != 0) {
+    std::cerr << path << " is not an emulator checkpoint\n";
+    os.close();
+    return false;
+  }
+  os >> trace_count;
+  os >> *tile;
+  os.close();
+  return true;
+}
+#endif
+
+// Parse a CPU list such as "0-3,8,10-11" in the order given
+static bool parse_cpu_list(const char* s, std::vector<int>& cpus)
+{
+  while (*s) {
+    char* end;
+    long first = strtol(s, &end, 10), last = first;
+    if (end == s || first < 0)
+      return false;
+    if (*end == '-') {
+      s = end + 1;
+      last = strtol(s, &end, 10);
+      if (end == s || last < first)
+        return false;
+    }
+    for (long cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+    if (*end == ',')
+      end++;
+    else if (*end)
+      return false;
+    s = end;
+  }
+  return !cpus.empty();
+}
+
+// Thread ids of this process
+static std::set<pid_t> list_threads()
+{
+  std::set<pid_t> tids;
+  DIR* dir = opendir("/proc/self/task");
+  if (!dir)
+    return tids;
+  while (struct dirent* ent = readdir(dir)) {
+    if (ent->d_name[0] != '.')
+      tids.insert(atoi(ent->d_name));
+  }
+  closedir(dir);
+  return tids;
+}
+
+static void pin_thread(pid_t tid, int cpu)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(tid, sizeof(set), &set) != 0)
+    fprintf(stderr, "warning: unable to pin thread %d to CPU %d\n", tid, cpu);
+}
+
+// Pin the emulator thread to the first CPU of cpus and each thread created
+// since before_tids, i.e. the model's evaluation threads, to the following
+// ones, round robin
+static void pin_threads(const std::vector<int>& cpus,
+                        const std::set<pid_t>& before_tids)
+{
+  size_t next = 0;
+  pin_thread(syscall(SYS_gettid), cpus[next++ % cpus.size()]);
+  for (pid_t tid : list_threads()) {
+    if (!before_tids.count(tid))
+      pin_thread(tid, cpus[next++ % cpus.size()]);
+  }
+  if (verbose)
+    fprintf(stderr, "pinned %zu threads\n", next);
+}
+
+#if VM_TRACE
+// Open path for the VCD. A .gz name is written through gzip, which runs as a
+// separate process so the compression does not slow down the simulation.
+static FILE* open_vcd(const char* path, pid_t* gzip)
+{
+  size_t len = strlen(path);
+  if (len < 3 || strcmp(path + len - 3, ".gz") != 0)
+    return fopen(path, "w");
+
+  int out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  int fds[2];
+  if (out < 0 || pipe(fds) < 0)
+    return NULL;
+  *gzip = fork();
+  if (*gzip == 0) {
+    dup2(fds[0], 0);
+    dup2(out, 1);
+    close(fds[0]);
+    close(fds[1]);
+    close(out);
+    execlp("gzip", "gzip", "-1", (char*)NULL);
+    perror("gzip");
+    _exit(1);
+  }
+  close(fds[0]);
+  close(out);
+  if (*gzip < 0)
+    return NULL;
+  return fdopen(fds[1], "w");
+}
+
+// The flight recorder of the run, if any, and the trace feeding it. A
+// failing run writes the recording at the end of main(), but an assertion
+// ($stop/$fatal) or an abort() never gets there, so those save it on their
+// way out too.
+static flight_recorder_t* flight_recorder;
+static VerilatedVcdC* flight_tfp;
+static const char* flight_path;
+
+static void save_flight_recorder()
+{
+  flight_recorder_t* recorder = flight_recorder;
+  if (!recorder)
+    return;
+  flight_recorder = NULL;
+  // The last cycles may still be buffered by the trace, unless it has been
+  // closed already
+  if (flight_tfp)
+    flight_tfp->flush();
+
+  pid_t gzip = 0;
+  FILE* file = strcmp(flight_path, "-") == 0 ? stdout : open_vcd(flight_path, &gzip);
+  if (!file || !recorder->save(file))
+    std::cerr << "Unable to write flight recorder trace to " << flight_path << "\n";
+  else
+    fprintf(stderr, "flight recorder trace written to %s\n", flight_path);
+  if (file && file != stdout)
+    fclose(file);
+  if (gzip)
+    waitpid(gzip, NULL, 0);
+}
+
+static void handle_fatal_signal(int sig)
+{
+  save_flight_recorder();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+#endif
+
+// Verilator's own versions print the message and abort(); these save the
+// flight recorder first (VL_USER_STOP and VL_USER_FATAL in VERILATOR_FLAGS)
+#ifdef VL_USER_FATAL
+void vl_fatal(const char* filename, int linenum, const char* hier, const char* msg)
+{
+  Verilated::gotFinish(true);
+  fprintf(stderr, "%%Error: %s:%d: %s\n", filename, linenum, msg);
+#if VM_TRACE
+  save_flight_recorder();
+#endif
+  fprintf(stderr, "Aborting...\n");
+  abort();
+}
+#endif
+
+#ifdef VL_USER_STOP
+void vl_stop(const char* filename, int linenum, const char* hier)
+{
+  vl_fatal(filename, linenum, hier, "Verilog $stop");
+}
+#endif
 
 static void usage(const char * program_name)
 {
@@ -72,9 +341,53 @@ EMULATOR OPTIONS\n\
   -r, --rbb-port=PORT      Use PORT for remote bit bang (with OpenOCD and GDB) \n\
                            If not specified, a random port will be chosen\n\
                            automatically.\n\
+  -p, --pin=CPUS           Pin the emulator to the first CPU of the list CPUS\n\
+                           (e.g. 0-3,8) and each model evaluation thread to\n\
+                           the next one\n\
+      --stats-json=FILE    Write simulation speed and phase timings to FILE\n\
+                           at exit; SIGUSR1 prints them to stderr meanwhile\n\
+      --progress=SECONDS   Print the cycle count and simulation speed to\n\
+                           stderr every SECONDS seconds\n\
+      --fast-forward       Skip cycles in which all harts wait in WFI and\n\
+                           the CREEC chain is idle, up to the next timer\n\
+                           interrupt or debug request\n\
+      --rtc-period=CYCLES  Cycles per mtime increment (default 100)\n\
+      --host-interval=N    Only service the DTM and JTAG every N cycles\n\
+                           while they are idle, and evaluate the model N\n\
+                           cycles at a time in between (default 1)\n\
+      --batch=FILE         Run each line of FILE (a BINARY and its TARGET\n\
+                           OPTIONs) in its own process forked from one\n\
+                           reset design, and print a report of the results;\n\
+                           HOST OPTIONs apply to every test\n\
+      --jobs=N             Run up to N tests of --batch at a time (default:\n\
+                           the number of CPUs)\n\
+      --batch-logs=DIR     Write the output of each test of --batch to\n\
+                           DIR/<index>-<binary name>.log\n\
   -V, --verbose            Enable all Chisel printfs (cycle-by-cycle info)\n\
        +verbose\n\
 ", stdout);
+#ifdef VERILATOR_VPI
+  fputs("\
+      --preload            Write the segments of BINARY straight into DRAM\n\
+                           rather than through the debug module; HTIF\n\
+                           (tohost/fromhost) works as usual\n\
+      --preload-mem=PATH   Hierarchical name of the DRAM byte lanes, without\n\
+                           the _<lane> suffix\n\
+                           (default TOP.TestHarness.SimAXIMem.AXI4RAM.mem)\n\
+      --preload-base=ADDR  Address of the first DRAM word (default 0x80000000)\n\
+", stdout);
+#endif
+#ifdef VERILATOR_SAVABLE
+  fputs("\
+      --save-checkpoint=FILE  Save the design to FILE once CYCLE cycles have\n\
+                           elapsed, then run BINARY. The debug transport\n\
+                           stays idle until then, so the checkpoint holds\n\
+                           the booted design before any program is loaded\n\
+      --checkpoint-cycle=CYCLE  Cycle of --save-checkpoint (default 1000)\n\
+      --restore-checkpoint=FILE  Start from the checkpoint in FILE instead of\n\
+                           resetting, and load and run BINARY from there\n\
+", stdout);
+#endif
 #if VM_TRACE == 0
   fputs("\
 \n\
@@ -82,10 +395,24 @@ EMULATOR DEBUG OPTIONS (only supported in debug build -- try `make debug`)\n",
         stdout);
 #endif
   fputs("\
-  -v, --vcd=FILE,          Write vcd trace to FILE (or '-' for stdout)\n\
+  -v, --vcd=FILE,          Write vcd trace to FILE (or '-' for stdout);\n\
+                           compressed with gzip if FILE ends in .gz\n\
   -x, --dump-start=CYCLE   Start VCD tracing at CYCLE\n\
        +dump-start\n\
+      --dump-stop=CYCLE    Stop VCD tracing at CYCLE\n\
+       +dump-stop\n\
+      --dump-scope=SCOPES  Only trace the instances in the comma-separated\n\
+                           list SCOPES (names or dotted paths, e.g.\n\
+                           creecChain or TestHarness.dut.creecChain)\n\
+      --dump-depth=LEVELS  Only trace LEVELS levels of hierarchy, counted\n\
+                           from each of SCOPES or from the top\n\
+      --flight-recorder=CYCLES  Keep the trace of the last CYCLES cycles in\n\
+                           memory and only write it to the --vcd FILE if\n\
+                           the run fails\n\
 ", stdout);
+#ifdef VERILATOR_THREADS
+  printf("\nThis model is evaluated by %d threads.\n", VERILATOR_THREADS);
+#endif
   fputs("\n" PLUSARG_USAGE_OPTIONS, stdout);
   fputs("\n" HTIF_USAGE_OPTIONS, stdout);
   printf("\n"
@@ -109,6 +436,8 @@ EMULATOR DEBUG OPTIONS (only supported in debug build -- try `make debug`)\n",
 
 int main(int argc, char** argv)
 {
+  sim_stats_t stats = {};
+  stats.start = sim_now();
   unsigned random_seed = (unsigned)time(NULL) ^ (unsigned)getpid();
   uint64_t max_cycles = -1;
   int ret = 0;
@@ -116,11 +445,31 @@ int main(int argc, char** argv)
   // Port numbers are 16 bit unsigned integers. 
   uint16_t rbb_port = 0;
 #if VM_TRACE
+  const char* vcd_path = NULL;
   FILE * vcdfile = NULL;
+  pid_t vcd_gzip = 0;
   uint64_t start = 0;
+  uint64_t stop = -1;
+  const char* dump_scope = NULL;
+  int dump_depth = 0;
+  uint64_t flight_cycles = 0;
 #endif
   char ** htif_argv = NULL;
   int verilog_plusargs_legal = 1;
+  std::vector<int> pin_cpus;
+  const char* stats_file = NULL;
+  double progress = 0;
+  bool fast_forward = false;
+  uint64_t rtc_period = 100;
+  const char* batch_file = NULL;
+  unsigned jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  const char* batch_logs = NULL;
+  const char* save_file = NULL;
+  const char* restore_file = NULL;
+  uint64_t checkpoint_cycle = 1000;
+  bool preload = false;
+  const char* preload_mem = "TOP.TestHarness.SimAXIMem.AXI4RAM.mem";
+  uint64_t preload_base = 0x80000000;
 
   while (1) {
     static struct option long_options[] = {
@@ -129,18 +478,41 @@ int main(int argc, char** argv)
       {"max-cycles",  required_argument, 0, 'm' },
       {"seed",        required_argument, 0, 's' },
       {"rbb-port",    required_argument, 0, 'r' },
+      {"pin",         required_argument, 0, 'p' },
+      {"stats-json",  required_argument, 0, OPT_STATS_JSON },
+      {"progress",    required_argument, 0, OPT_PROGRESS },
+      {"fast-forward", no_argument,      0, OPT_FAST_FORWARD },
+      {"rtc-period",  required_argument, 0, OPT_RTC_PERIOD },
+      {"host-interval", required_argument, 0, OPT_HOST_INTERVAL },
+      {"batch",       required_argument, 0, OPT_BATCH },
+      {"jobs",        required_argument, 0, OPT_JOBS },
+      {"batch-logs",  required_argument, 0, OPT_BATCH_LOGS },
+#ifdef VERILATOR_VPI
+      {"preload",            no_argument,       0, OPT_PRELOAD },
+      {"preload-mem",        required_argument, 0, OPT_PRELOAD_MEM },
+      {"preload-base",       required_argument, 0, OPT_PRELOAD_BASE },
+#endif
+#ifdef VERILATOR_SAVABLE
+      {"save-checkpoint",    required_argument, 0, OPT_SAVE_CHECKPOINT },
+      {"restore-checkpoint", required_argument, 0, OPT_RESTORE_CHECKPOINT },
+      {"checkpoint-cycle",   required_argument, 0, OPT_CHECKPOINT_CYCLE },
+#endif
       {"verbose",     no_argument,       0, 'V' },
 #if VM_TRACE
       {"vcd",         required_argument, 0, 'v' },
       {"dump-start",  required_argument, 0, 'x' },
+      {"dump-stop",   required_argument, 0, OPT_DUMP_STOP },
+      {"dump-scope",  required_argument, 0, OPT_DUMP_SCOPE },
+      {"dump-depth",  required_argument, 0, OPT_DUMP_DEPTH },
+      {"flight-recorder", required_argument, 0, OPT_FLIGHT_RECORDER },
 #endif
       HTIF_LONG_OPTIONS
     };
     int option_index = 0;
 #if VM_TRACE
-    int c = getopt_long(argc, argv, "-chm:s:r:v:Vx:", long_options, &option_index);
+    int c = getopt_long(argc, argv, "-chm:s:r:p:v:Vx:", long_options, &option_index);
 #else
-    int c = getopt_long(argc, argv, "-chm:s:r:V", long_options, &option_index);
+    int c = getopt_long(argc, argv, "-chm:s:r:p:V", long_options, &option_index);
 #endif
     if (c == -1) break;
  retry:
@@ -152,17 +524,46 @@ int main(int argc, char** argv)
       case 'm': max_cycles = atoll(optarg); break;
       case 's': random_seed = atoi(optarg); break;
       case 'r': rbb_port = atoi(optarg);    break;
+      case 'p': {
+        if (!parse_cpu_list(optarg, pin_cpus)) {
+          std::cerr << "Invalid CPU list " << optarg << "\n";
+          return 1;
+        }
+        break;
+      }
       case 'V': verbose = true;             break;
-#if VM_TRACE
-      case 'v': {
-        vcdfile = strcmp(optarg, "-") == 0 ? stdout : fopen(optarg, "w");
-        if (!vcdfile) {
-          std::cerr << "Unable to open " << optarg << " for VCD write\n";
+      case OPT_STATS_JSON: stats_file = optarg;        break;
+      case OPT_PROGRESS:   progress = atof(optarg);    break;
+      case OPT_FAST_FORWARD: fast_forward = true;      break;
+      case OPT_RTC_PERIOD: rtc_period = atoll(optarg); break;
+      case OPT_HOST_INTERVAL: host_interval = std::max(atoi(optarg), 1); break;
+      case OPT_BATCH:      batch_file = optarg;        break;
+      case OPT_JOBS: {
+        if (atoi(optarg) < 1) {
+          std::cerr << "Invalid job count " << optarg << "\n";
           return 1;
         }
+        jobs = atoi(optarg);
         break;
       }
+      case OPT_BATCH_LOGS: batch_logs = optarg;        break;
+#ifdef VERILATOR_VPI
+      case OPT_PRELOAD:            preload = true;                          break;
+      case OPT_PRELOAD_MEM:        preload_mem = optarg;                    break;
+      case OPT_PRELOAD_BASE:       preload_base = strtoull(optarg, NULL, 0); break;
+#endif
+#ifdef VERILATOR_SAVABLE
+      case OPT_SAVE_CHECKPOINT:    save_file = optarg;               break;
+      case OPT_RESTORE_CHECKPOINT: restore_file = optarg;            break;
+      case OPT_CHECKPOINT_CYCLE:   checkpoint_cycle = atoll(optarg); break;
+#endif
+#if VM_TRACE
+      case 'v': vcd_path = optarg;          break;
       case 'x': start = atoll(optarg);      break;
+      case OPT_DUMP_STOP:  stop = atoll(optarg);       break;
+      case OPT_DUMP_SCOPE: dump_scope = optarg;        break;
+      case OPT_DUMP_DEPTH: dump_depth = atoi(optarg);  break;
+      case OPT_FLIGHT_RECORDER: flight_cycles = atoll(optarg); break;
 #endif
       // Process legacy '+' EMULATOR arguments by replacing them with
       // their getopt equivalents
@@ -183,6 +584,10 @@ int main(int argc, char** argv)
           c = 'x';
           optarg = optarg+12;
         }
+        else if (arg.substr(0, 11) == "+dump-stop=") {
+          c = OPT_DUMP_STOP;
+          optarg = optarg+11;
+        }
 #endif
         else if (arg.substr(0, 12) == "+cycle-count")
           c = 'c';
@@ -236,11 +641,28 @@ int main(int argc, char** argv)
   }
 
 done_processing:
-  if (optind == argc) {
+  if (optind == argc && !batch_file) {
     std::cerr << "No binary specified for emulator\n";
     usage(argv[0]);
     return 1;
   }
+  // The workers of a batch run share the design's reset and the emulator's
+  // options, but not its output files, CPUs or threads
+  if (batch_file) {
+    bool vcd = false;
+#if VM_TRACE
+    vcd = vcd_path != NULL;
+#endif
+#ifdef VERILATOR_THREADS
+    std::cerr << "--batch is not supported by the multithreaded model\n";
+    return 1;
+#endif
+    if (vcd || stats_file || save_file || rbb_port || !pin_cpus.empty()) {
+      std::cerr << "--batch cannot be used with --vcd, --stats-json, "
+                   "--save-checkpoint, --rbb-port or --pin\n";
+      return 1;
+    }
+  }
   int htif_argc = 1 + argc - optind;
   htif_argv = (char **) malloc((htif_argc) * sizeof (char *));
   htif_argv[0] = argv[0];
@@ -254,31 +676,147 @@ done_processing:
 
   Verilated::randReset(2);
   Verilated::commandArgs(argc, argv);
+  // A multithreaded model starts its evaluation threads when constructed
+  std::set<pid_t> before_tids = list_threads();
   TEST_HARNESS *tile = new TEST_HARNESS;
+  if (!pin_cpus.empty())
+    pin_threads(pin_cpus, before_tids);
 
 #if VM_TRACE
   Verilated::traceEverOn(true); // Verilator must compute traced signals
-  std::unique_ptr<VerilatedVcdFILE> vcdfd(new VerilatedVcdFILE(vcdfile));
+  std::unique_ptr<vcd_filter_t> vcd_filter;
+  if (dump_scope || dump_depth > 0)
+    vcd_filter.reset(new vcd_filter_t(dump_scope, dump_depth));
+  // With the flight recorder the VCD is only opened if there is a failure
+  std::unique_ptr<flight_recorder_t> recorder;
+  if (vcd_path && flight_cycles)
+    recorder.reset(new flight_recorder_t(flight_cycles));
+  else if (vcd_path) {
+    vcdfile = strcmp(vcd_path, "-") == 0 ? stdout : open_vcd(vcd_path, &vcd_gzip);
+    if (!vcdfile) {
+      std::cerr << "Unable to open " << vcd_path << " for VCD write\n";
+      return 1;
+    }
+  }
+  std::unique_ptr<VerilatedVcdFILE> vcdfd(
+    new VerilatedVcdFILE(vcdfile, vcd_filter.get(), recorder.get()));
   std::unique_ptr<VerilatedVcdC> tfp(new VerilatedVcdC(vcdfd.get()));
-  if (vcdfile) {
+  if (vcd_path) {
     tile->trace(tfp.get(), 99);  // Trace 99 levels of hierarchy
     tfp->open("");
   }
+  if (recorder) {
+    flight_recorder = recorder.get();
+    flight_tfp = tfp.get();
+    flight_path = vcd_path;
+    signal(SIGABRT, handle_fatal_signal);
+    signal(SIGSEGV, handle_fatal_signal);
+  }
+#endif
+
+#ifdef VERILATOR_SAVABLE
+  dtm_hold = save_file != NULL;
+  if (restore_file) {
+    if (!restore_checkpoint(restore_file, tile)) {
+      std::cerr << "Unable to restore checkpoint " << restore_file << "\n";
+      return 1;
+    }
+    if (verbose)
+      fprintf(stderr, "restored %s at cycle %ld\n", restore_file, trace_count);
+  }
 #endif
 
   jtag = new remote_bitbang_t(rbb_port);
-  dtm = new dtm_t(htif_argc, htif_argv);
+
+  // In batch mode the design is reset once, before there is a DTM, which is
+  // held off meanwhile, and each worker goes on from there with its own test
+  // as if it had been given on the command line
+  if (batch_file) {
+    std::vector<batch_test_t> tests;
+    if (!batch_read(batch_file, tests)) {
+      std::cerr << "Unable to read " << batch_file << "\n";
+      return 1;
+    }
+    dtm_hold = true;
+    for (int i = 0; i < 10 && !restore_file; i++) {
+      tile->reset = 1;
+      tile->clock = 0;
+      tile->eval();
+      tile->clock = 1;
+      tile->eval();
+      trace_count ++;
+    }
+    tile->reset = 0;
+    dtm_hold = false;
+
+    int status;
+    int test = batch_run(tests, jobs, batch_logs, &status);
+    if (test < 0) {
+      delete jtag;
+      delete tile;
+      free(htif_argv);
+      return status;
+    }
+    htif_argv = (char **) realloc(htif_argv,
+                                  (htif_argc + tests[test].size()) * sizeof (char *));
+    for (const std::string& word : tests[test])
+      htif_argv[htif_argc++] = strdup(word.c_str());
+  }
+
+#ifdef VERILATOR_VPI
+  // Load the binary into DRAM here and give the DTM a copy without any
+  // segments, from which it only takes the entry point and HTIF symbols
+  // Removed however main() returns from here on
+  struct preload_stub_t {
+    std::string path;
+    ~preload_stub_t() { if (!path.empty()) unlink(path.c_str()); }
+  } preload_stub;
+  if (preload) {
+    int bin = 1;
+    while (bin < htif_argc && (htif_argv[bin][0] == '-' || htif_argv[bin][0] == '+'))
+      bin++;
+    if (bin == htif_argc ||
+        !preload_elf(htif_argv[bin], preload_mem, preload_base, preload_stub.path))
+      return 1;
+    if (verbose)
+      fprintf(stderr, "preloaded %s into DRAM\n", htif_argv[bin]);
+    htif_argv[bin] = (char *) preload_stub.path.c_str();
+  }
+#endif
+
+  dtm_call([&] { dtm = new dtm_t(htif_argc, htif_argv); });
 
   signal(SIGTERM, handle_sigterm);
+  signal(SIGUSR1, handle_sigusr1);
+
+  // Fast-forwarding ticks the DTM itself, so it cannot be combined with
+  // holding it off for a checkpoint, nor with a JTAG client
+  std::unique_ptr<fast_forward_t> ff;
+  uint64_t ff_hold = 0;
+  if (fast_forward && (save_file || rbb_port)) {
+    std::cerr << "--fast-forward cannot be used with --save-checkpoint or --rbb-port\n";
+    return 1;
+  } else if (fast_forward) {
+    ff.reset(new fast_forward_t(rtc_period));
+    if (!ff->ok())
+      return 1;
+    if (verbose)
+      fprintf(stderr, "fast-forward: %u harts\n", ff->harts());
+  }
+
+  // Only time the DTM, JTAG and eval() calls if asked to
+  if (stats_file || progress > 0)
+    sim_stats = &stats;
+  stats.built = sim_now();
 
   bool dump;
   // reset for several cycles to handle pipelined reset
-  for (int i = 0; i < 10; i++) {
+  for (int i = 0; i < 10 && !restore_file && !batch_file; i++) {
     tile->reset = 1;
     tile->clock = 0;
     tile->eval();
 #if VM_TRACE
-    dump = tfp && trace_count >= start;
+    dump = vcd_path && trace_count >= start && trace_count < stop;
     if (dump)
       tfp->dump(static_cast<vluint64_t>(trace_count * 2));
 #endif
@@ -292,54 +830,156 @@ done_processing:
   }
   tile->reset = 0;
   done_reset = true;
+  stats.reset_done = sim_now();
+
+  double next_progress = stats.reset_done + progress;
+  uint64_t progress_count = trace_count;
+  uint64_t progress_check = trace_count;
 
   while (!dtm->done() && !jtag->done() &&
          !tile->io_success && trace_count < max_cycles) {
-    tile->clock = 0;
-    tile->eval();
+#ifdef VERILATOR_SAVABLE
+    if (save_file && dtm_hold && trace_count >= checkpoint_cycle) {
+      if (!save_checkpoint(save_file, tile)) {
+        std::cerr << "Unable to save checkpoint " << save_file << "\n";
+        return 1;
+      }
+      if (verbose)
+        fprintf(stderr, "saved %s at cycle %ld\n", save_file, trace_count);
+      dtm_hold = false;
+    }
+#endif
+    if (stats_snapshot) {
+      stats_snapshot = 0;
+      sim_stats_json(stderr, &stats, trace_count, NULL, 0);
+    }
+    if (progress > 0 && trace_count >= progress_check) {
+      progress_check = trace_count + 4096;
+      double now = sim_now();
+      if (now >= next_progress) {
+        fprintf(stderr, "[%.0fs] cycle %ld, %.0f cycles/s\n",
+                now - stats.start, trace_count,
+                (trace_count - progress_count) / (now - next_progress + progress));
+        next_progress = now + progress;
+        progress_count = trace_count;
+      }
+    }
+
+    // Skip whole RTC periods while nothing can happen but the DTM's host
+    // thread idling. The DTM is ticked for every skipped cycle and stops the
+    // skip with its next request; the cycles of the last, partial period are
+    // then evaluated with the DTM held, as it is already past them.
+    if (ff) {
+      if (!ff_hold && !dtm_busy && !dtm->req_valid() && !dtm->done() &&
+          ff->idle()) {
+        uint64_t limit = std::min(max_cycles - trace_count - 1, ff->timer_cycles());
 #if VM_TRACE
-    dump = tfp && trace_count >= start;
-    if (dump)
-      tfp->dump(static_cast<vluint64_t>(trace_count * 2));
+        if (vcd_path && trace_count < stop)
+          limit = trace_count < start ? std::min(limit, start - trace_count) : 0;
 #endif
+        dtm_t::resp resp = {};
+        uint64_t n = 0;
+        dtm_call([&] {
+          while (n < limit && !dtm->req_valid() && !dtm->done()) {
+            dtm->tick(false, false, resp);
+            n++;
+          }
+        });
+        uint64_t periods = n / ff->period;
+        ff->advance(periods);
+        trace_count += periods * ff->period;
+        stats.skipped += periods * ff->period;
+        ff_hold = n % ff->period;
+      }
+      dtm_hold = ff_hold > 0;
+      if (ff_hold)
+        ff_hold--;
+    }
 
-    tile->clock = 1;
-    tile->eval();
+    // Run up to the next cycle at which the host agents are serviced before
+    // coming back to the bookkeeping above. Only the exit conditions are
+    // checked in between, so the run ends on the same cycle.
+    uint64_t batch_end = trace_count + 1;
+    if (host_interval > 1 && !ff)
+      batch_end = std::min(max_cycles, (trace_count / host_interval + 1) * host_interval);
+    do {
+      tile->clock = 0;
+      eval(tile);
 #if VM_TRACE
-    if (dump)
-      tfp->dump(static_cast<vluint64_t>(trace_count * 2 + 1));
+      dump = vcd_path && trace_count >= start && trace_count < stop;
+      if (dump)
+        dump_trace(tfp.get(), static_cast<vluint64_t>(trace_count * 2));
+#endif
+
+      tile->clock = 1;
+      eval(tile);
+#if VM_TRACE
+      if (dump)
+        dump_trace(tfp.get(), static_cast<vluint64_t>(trace_count * 2 + 1));
 #endif
-    trace_count++;
+      trace_count++;
+    } while (trace_count < batch_end && !dtm->done() && !jtag->done() &&
+             !tile->io_success);
   }
 
 #if VM_TRACE
+  flight_tfp = NULL;
   if (tfp)
     tfp->close();
   if (vcdfile)
     fclose(vcdfile);
+  if (vcd_gzip)
+    waitpid(vcd_gzip, NULL, 0);
 #endif
 
+  const char* exit_reason = "success";
   if (dtm->exit_code())
   {
     fprintf(stderr, "*** FAILED *** via dtm (code = %d, seed %d) after %ld cycles\n", dtm->exit_code(), random_seed, trace_count);
     ret = dtm->exit_code();
+    exit_reason = "dtm";
   }
   else if (jtag->exit_code())
   {
     fprintf(stderr, "*** FAILED *** via jtag (code = %d, seed %d) after %ld cycles\n", jtag->exit_code(), random_seed, trace_count);
     ret = jtag->exit_code();
+    exit_reason = "jtag";
   }
   else if (trace_count == max_cycles)
   {
     fprintf(stderr, "*** FAILED *** via trace_count (timeout, seed %d) after %ld cycles\n", random_seed, trace_count);
     ret = 2;
+    exit_reason = "timeout";
   }
   else if (verbose || print_cycles)
   {
     fprintf(stderr, "Completed after %ld cycles\n", trace_count);
   }
+  if (ff && verbose)
+    fprintf(stderr, "fast-forwarded over %lu cycles\n", (unsigned long)stats.skipped);
+
+  if (batch_result) {
+    batch_result->cycles = trace_count;
+    strncpy(batch_result->exit, exit_reason, sizeof(batch_result->exit) - 1);
+  }
+
+  if (stats_file) {
+    FILE* f = fopen(stats_file, "w");
+    if (f) {
+      sim_stats_json(f, &stats, trace_count, exit_reason, ret);
+      fclose(f);
+    } else {
+      std::cerr << "Unable to write " << stats_file << "\n";
+    }
+  }
+
+#if VM_TRACE
+  if (ret)
+    save_flight_recorder();
+  flight_recorder = NULL;
+#endif
 
-  if (dtm) delete dtm;
+  if (dtm) dtm_call([&] { delete dtm; });
   if (jtag) delete jtag;
   if (tile) delete tile;
   if (htif_argv) free(htif_argv);
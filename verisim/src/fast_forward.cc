@@ -0,0 +1,109 @@
+#include "fast_forward.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "verilated.h"
+#include "verilated_syms.h"
+
+static uint64_t get(const VerilatedVar* var)
+{
+  switch (var->vltype()) {
+    case VLVT_UINT8:  return *(CData*)var->datap();
+    case VLVT_UINT16: return *(SData*)var->datap();
+    case VLVT_UINT32: return *(IData*)var->datap();
+    case VLVT_UINT64: return *(QData*)var->datap();
+    default:          return 0;
+  }
+}
+
+static void set(const VerilatedVar* var, uint64_t value)
+{
+  switch (var->vltype()) {
+    case VLVT_UINT8:  *(CData*)var->datap() = value; break;
+    case VLVT_UINT16: *(SData*)var->datap() = value; break;
+    case VLVT_UINT32: *(IData*)var->datap() = value; break;
+    case VLVT_UINT64: *(QData*)var->datap() = value; break;
+    default:          break;
+  }
+}
+
+static bool suffix(const char* s, const char* end)
+{
+  size_t n = strlen(s), m = strlen(end);
+  return n >= m && strcmp(s + n - m, end) == 0;
+}
+
+// FIRRTL renames the CLINT's time register, a Verilog keyword
+static bool is_mtime(const char* name)
+{
+  return !strcmp(name, "time") || !strcmp(name, "time$") ||
+         !strcmp(name, "time_") || !strcmp(name, "time__024");
+}
+
+fast_forward_t::fast_forward_t(uint64_t period)
+  : period(period), ok_(false), creec_idle(NULL), mtime(NULL)
+{
+  const VerilatedScopeNameMap* scopes = Verilated::scopeNameMap();
+  if (!scopes)
+    return;
+  for (const auto& scope : *scopes) {
+    const VerilatedVarNameMap* vars = scope.second->varsp();
+    if (!vars)
+      continue;
+    for (const auto& var : *vars) {
+      if (!strcmp(var.first, "reg_wfi"))
+        wfi.push_back(&var.second);
+      else if (!strcmp(var.first, "idle") && strstr(scope.first, "creecChain"))
+        creec_idle = &var.second;
+      else if (suffix(scope.first, ".clint") && is_mtime(var.first))
+        mtime = &var.second;
+      else if (suffix(scope.first, ".clint") && !strncmp(var.first, "timecmp_", 8))
+        mtimecmp.push_back(&var.second);
+    }
+  }
+
+  const char* missing = wfi.empty() ? "the harts' reg_wfi" :
+                        !creec_idle ? "the CREEC chain's idle output" :
+                        !mtime ? "the CLINT's time register" :
+                        mtimecmp.empty() ? "the CLINT's timecmp registers" : NULL;
+  if (missing) {
+    fprintf(stderr, "fast-forward: cannot find %s (built without public.awk?)\n",
+            missing);
+    return;
+  }
+  if (mtime->vltype() != VLVT_UINT64 && mtime->vltype() != VLVT_UINT32) {
+    fprintf(stderr, "fast-forward: unexpected width of the CLINT's time register\n");
+    return;
+  }
+  ok_ = true;
+}
+
+bool fast_forward_t::idle() const
+{
+  for (const VerilatedVar* var : wfi) {
+    if (!get(var))
+      return false;
+  }
+  return get(creec_idle);
+}
+
+uint64_t fast_forward_t::timer_cycles() const
+{
+  uint64_t now = get(mtime);
+  uint64_t next = -1;
+  for (const VerilatedVar* var : mtimecmp)
+    next = std::min(next, get(var));
+  // Stop one increment short, so the timer interrupt is raised by a cycle
+  // that is evaluated
+  if (next <= now + 1)
+    return 0;
+  if (next - now - 1 > (uint64_t)-1 / period)
+    return -1;
+  return (next - now - 1) * period;
+}
+
+void fast_forward_t::advance(uint64_t periods)
+{
+  set(mtime, get(mtime) + periods);
+}
@@ -0,0 +1,50 @@
+#ifndef FAST_FORWARD_H
+#define FAST_FORWARD_H
+
+#include <stdint.h>
+#include <vector>
+
+class VerilatedVar;
+
+// Skips over cycles in which the design cannot change state except for its
+// timer, instead of evaluating them.
+//
+// The design is idle when every hart waits in WFI (reg_wfi of its CSR file)
+// and the CREEC chain reports idle. Nothing then happens until an interrupt
+// or a debug request: the only interrupt source left is the CLINT timer, and
+// the emulator stops short of the cycle mtime reaches the nearest mtimecmp,
+// while debug requests are left to the emulator, which ticks the DTM on its
+// own while skipping. Skipping whole RTC periods keeps the RTC divider in
+// phase, so the skipped cycles only add to mtime. Rocket does not count
+// mcycle while in WFI, so no other counter needs adjusting.
+//
+// The signals are the ones public.awk makes public, found by name among
+// Verilator's scopes once the model is constructed.
+class fast_forward_t
+{
+ public:
+  // period is the number of cycles per mtime increment
+  fast_forward_t(uint64_t period);
+
+  // Whether all the signals were found; if not, fast-forwarding is
+  // unavailable and the reason has been printed
+  bool ok() const { return ok_; }
+  unsigned harts() const { return wfi.size(); }
+
+  bool idle() const;
+  // Number of cycles that can be skipped before the timer fires
+  uint64_t timer_cycles() const;
+  // Add the mtime increments of periods skipped RTC periods
+  void advance(uint64_t periods);
+
+  const uint64_t period;
+
+ private:
+  bool ok_;
+  std::vector<const VerilatedVar*> wfi;
+  const VerilatedVar* creec_idle;
+  const VerilatedVar* mtime;
+  std::vector<const VerilatedVar*> mtimecmp;
+};
+
+#endif
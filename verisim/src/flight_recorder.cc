@@ -0,0 +1,91 @@
+#include "flight_recorder.h"
+#include "vcd_filter.h"
+
+#include <string.h>
+
+flight_recorder_t::flight_recorder_t(uint64_t cycles)
+  : in_header(true), slots(2 * cycles), head(0), count(0)
+{
+}
+
+void flight_recorder_t::evict(const std::string& slot)
+{
+  const char* p = slot.data();
+  const char* end = p + slot.size();
+
+  while (p < end) {
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    size_t id, len = nl - p;
+    if (p[0] == '#') {
+      state_time.assign(p, len + 1);
+    } else if (vcd_value_change(p, len, id)) {
+      if (id >= state.size())
+        state.resize(id + 1);
+      state[id].assign(p, len + 1);
+    }
+    p = nl + 1;
+  }
+}
+
+void flight_recorder_t::line(const char* p, size_t len)
+{
+  if (in_header) {
+    header.append(p, len).push_back('\n');
+    while (len && (*p == ' ' || *p == '\t'))
+      p++, len--;
+    if (len >= 15 && strncmp(p, "$enddefinitions", 15) == 0)
+      in_header = false;
+    return;
+  }
+
+  if (len && p[0] == '#') {
+    if (count == slots.size()) {
+      evict(slots[head]);
+      head = (head + 1) % slots.size();
+      count--;
+    }
+    // assign() reuses the slot's storage, so a full ring stops allocating
+    slots[(head + count++) % slots.size()].assign(p, len).push_back('\n');
+  } else if (count) {
+    slots[(head + count - 1) % slots.size()].append(p, len).push_back('\n');
+  }
+}
+
+void flight_recorder_t::write(const char* bufp, size_t len)
+{
+  const char* p = bufp;
+  const char* end = bufp + len;
+
+  if (slots.empty())
+    return;
+  while (p < end) {
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    if (!nl) {
+      partial.append(p, end - p);
+      break;
+    }
+    if (partial.empty()) {
+      line(p, nl - p);
+    } else {
+      partial.append(p, nl - p);
+      line(partial.data(), partial.size());
+      partial.clear();
+    }
+    p = nl + 1;
+  }
+}
+
+bool flight_recorder_t::save(FILE* file) const
+{
+  fputs(header.c_str(), file);
+  if (!state_time.empty()) {
+    fputs(state_time.c_str(), file);
+    fputs("$dumpvars\n", file);
+    for (const std::string& value : state)
+      fputs(value.c_str(), file);
+    fputs("$end\n", file);
+  }
+  for (size_t i = 0; i < count; i++)
+    fputs(slots[(head + i) % slots.size()].c_str(), file);
+  return fflush(file) == 0 && !ferror(file);
+}
@@ -0,0 +1,40 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Keeps the last cycles cycles of the VCD stream of VerilatedVcdC in memory,
+// so that a run can trace all along and only write a waveform if it fails.
+//
+// The stream is split at its timestamps into a ring of slots, two per cycle.
+// The value changes of a slot that falls out of the ring are folded into a
+// table of current values, which save() writes as a $dumpvars block ahead of
+// the slots still held, so the waveform is complete from its first cycle.
+// Memory use is that of cycles cycles of trace text plus one value per
+// signal; combine with --dump-scope to record fewer signals.
+class flight_recorder_t
+{
+ public:
+  flight_recorder_t(uint64_t cycles);
+
+  // Take len bytes of VCD text, which need not end on a line boundary
+  void write(const char* bufp, size_t len);
+  bool save(FILE* file) const;
+
+ private:
+  void line(const char* p, size_t len);
+  void evict(const std::string& slot);
+
+  bool in_header;
+  std::string header;
+  std::string partial;
+  std::vector<std::string> slots;
+  size_t head, count;
+  std::string state_time;          // timestamp of the values in state
+  std::vector<std::string> state;  // last value change of each signal
+};
+
+#endif
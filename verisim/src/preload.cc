@@ -0,0 +1,136 @@
+#include "preload.h"
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "verilated.h"
+#include "verilated_syms.h"
+
+#ifndef EM_RISCV
+#define EM_RISCV 243
+#endif
+
+// The lanes are written in place through their model variables, which are
+// found by name in Verilator's scope table like vpi_handle_by_name() would
+class dram_t
+{
+ public:
+  dram_t(const char* mem_path, uint64_t base) : base(base), words(0)
+  {
+    std::string path = mem_path;
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos)
+      return;
+    const VerilatedScope* scope = Verilated::scopeFind(path.substr(0, dot).c_str());
+    if (!scope)
+      return;
+    for (int i = 0; ; i++) {
+      std::string name = path.substr(dot + 1) + "_" + std::to_string(i);
+      const VerilatedVar* var = scope->varFind(name.c_str());
+      if (!var || var->vltype() != VLVT_UINT8 || var->dims() != 1)
+        break;
+      if (i == 0)
+        words = var->unpacked().elements();
+      else if ((uint64_t)var->unpacked().elements() != words)
+        break;
+      lanes.push_back((uint8_t*)var->datap());
+    }
+  }
+
+  bool ok() const { return !lanes.empty() && words > 0; }
+  uint64_t size() const { return words * lanes.size(); }
+
+  bool contains(uint64_t addr, uint64_t len) const
+  {
+    return addr >= base && addr - base <= size() && len <= size() - (addr - base);
+  }
+
+  void write(uint64_t addr, uint8_t byte)
+  {
+    uint64_t off = addr - base;
+    lanes[off % lanes.size()][off / lanes.size()] = byte;
+  }
+
+ private:
+  uint64_t base;
+  uint64_t words;
+  std::vector<uint8_t*> lanes;
+};
+
+static bool read_file(const char* path, std::vector<char>& buf)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return false;
+  fseek(f, 0, SEEK_END);
+  buf.resize(ftell(f));
+  fseek(f, 0, SEEK_SET);
+  bool ok = fread(buf.data(), 1, buf.size(), f) == buf.size();
+  fclose(f);
+  return ok;
+}
+
+bool preload_elf(const char* elf_path, const char* mem_path, uint64_t base,
+                 std::string& stub_path)
+{
+  std::vector<char> buf;
+  if (!read_file(elf_path, buf)) {
+    fprintf(stderr, "preload: unable to read %s\n", elf_path);
+    return false;
+  }
+
+  Elf64_Ehdr* eh = (Elf64_Ehdr*)buf.data();
+  if (buf.size() < sizeof(*eh) || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+      eh->e_ident[EI_CLASS] != ELFCLASS64 || eh->e_machine != EM_RISCV ||
+      eh->e_phoff + (uint64_t)eh->e_phnum * sizeof(Elf64_Phdr) > buf.size()) {
+    fprintf(stderr, "preload: %s is not an RV64 ELF\n", elf_path);
+    return false;
+  }
+
+  dram_t dram(mem_path, base);
+  if (!dram.ok()) {
+    fprintf(stderr, "preload: no memory named %s_0 (built without a public DRAM?)\n",
+            mem_path);
+    return false;
+  }
+
+  Elf64_Phdr* ph = (Elf64_Phdr*)(buf.data() + eh->e_phoff);
+  for (int i = 0; i < eh->e_phnum; i++) {
+    if (ph[i].p_type != PT_LOAD || ph[i].p_memsz == 0)
+      continue;
+    if (ph[i].p_offset + ph[i].p_filesz > buf.size() ||
+        !dram.contains(ph[i].p_paddr, ph[i].p_memsz)) {
+      fprintf(stderr, "preload: segment %d of %s at 0x%lx does not fit in DRAM\n",
+              i, elf_path, (unsigned long)ph[i].p_paddr);
+      return false;
+    }
+    // The memory starts out random, so .bss is cleared as fesvr would
+    const uint8_t* data = (const uint8_t*)buf.data() + ph[i].p_offset;
+    for (uint64_t off = 0; off < ph[i].p_memsz; off++)
+      dram.write(ph[i].p_paddr + off, off < ph[i].p_filesz ? data[off] : 0);
+  }
+
+  eh->e_phoff = 0;
+  eh->e_phnum = 0;
+  char tmp[] = "/tmp/emulator-preload-XXXXXX";
+  int fd = mkstemp(tmp);
+  if (fd < 0) {
+    perror("preload: mkstemp");
+    return false;
+  }
+  bool ok = ::write(fd, buf.data(), buf.size()) == (ssize_t)buf.size();
+  close(fd);
+  if (!ok) {
+    fprintf(stderr, "preload: unable to write %s\n", tmp);
+    unlink(tmp);
+    return false;
+  }
+  stub_path = tmp;
+  return true;
+}
@@ -0,0 +1,22 @@
+#ifndef PRELOAD_H
+#define PRELOAD_H
+
+#include <stdint.h>
+#include <string>
+
+// Load the segments of an RV64 ELF straight into the simulated DRAM, the
+// AXI4RAM behind connectSimAXIMem, instead of through the debug module.
+//
+// The memory is found by hierarchical name as byte lanes <mem_path>_0,
+// <mem_path>_1, ..., one per byte of the AXI beat, with word 0 at address
+// base, and written directly in the model. The lanes are made public by the
+// simulator build (see public.awk).
+//
+// The DTM still needs the entry point and the tohost/fromhost symbols, so
+// a copy of the ELF without program headers is written to a temporary file
+// whose name is returned in stub_path: fesvr reads its symbols and entry
+// point but has nothing to load. The caller should unlink it when done.
+bool preload_elf(const char* elf_path, const char* mem_path, uint64_t base,
+                 std::string& stub_path);
+
+#endif
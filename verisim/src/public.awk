@@ -0,0 +1,24 @@
+# Mark the signals the emulator reaches into as Verilator public, so that
+# they keep their names and can be found at run time:
+#   - the DRAM byte lanes of AXI4RAM, written by --preload over VPI
+#   - each hart's WFI state, the CLINT timer registers and the idle output
+#     of the CREEC chain, used by --fast-forward
+# The attribute goes before the first ';' or ',' of the declaration.
+function tag(kind) {
+  if (match($0, /[;,]/))
+    $0 = substr($0, 1, RSTART - 1) " /*verilator " kind "*/" substr($0, RSTART)
+  else
+    $0 = $0 " /*verilator " kind "*/"
+}
+
+/^module / {
+  module = $2
+  sub(/\(.*/, "", module)
+}
+
+module == "AXI4RAM" && /^ *reg \[7:0\] mem_[0-9]+ \[/ { tag("public_flat_rw") }
+module == "CSRFile" && /^ *reg +reg_wfi[ ;]/ { tag("public_flat_rd") }
+module == "CLINT" && /^ *reg / { tag("public_flat_rw") }
+module ~ /^CREECelerator(Read)?Thing$/ && /^ *output +idle *,?$/ { tag("public_flat_rd") }
+
+{ print }
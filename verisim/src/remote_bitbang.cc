@@ -114,11 +114,20 @@ void remote_bitbang_t::tick(
     this->accept();
   }
 
+  hold(jtag_tck, jtag_tms, jtag_tdi, jtag_trstn);
+}
+
+void remote_bitbang_t::hold(
+                            unsigned char * jtag_tck,
+                            unsigned char * jtag_tms,
+                            unsigned char * jtag_tdi,
+                            unsigned char * jtag_trstn
+                            )
+{
   * jtag_tck = tck;
   * jtag_tms = tms;
   * jtag_tdi = tdi;
   * jtag_trstn = trstn;
-
 }
 
 void remote_bitbang_t::reset(){
@@ -20,6 +20,12 @@ public:
             unsigned char * jtag_trstn,
             unsigned char jtag_tdo);
 
+  // Drive the pins as last set by the client, without talking to it.
+  void hold(unsigned char * jtag_tck,
+            unsigned char * jtag_tms,
+            unsigned char * jtag_tdi,
+            unsigned char * jtag_trstn);
+
   unsigned char done() {return quit;}
   
   int exit_code() {return err;}
@@ -0,0 +1,69 @@
+#include "sim_stats.h"
+
+sim_stats_t* sim_stats;
+
+// Debug module registers and the DMI write operation (debug spec 0.13)
+#define DMI_DMCONTROL           0x10
+#define DMI_PROGBUF0            0x20
+#define DMI_OP_WRITE            2
+#define DMCONTROL_RESUMEREQ     (1U << 30)
+
+// fesvr's dtm_t::reset() points each hart at the entry point with a
+// "csrw dpc, ..." in the program buffer and then resumes it, so the first
+// resume after such a write is where the program starts. Later memory
+// accesses halt and resume the hart too, but never write dpc.
+void sim_stats_dmi(sim_stats_t* stats, int addr, int op, uint32_t data,
+                   uint64_t cycle)
+{
+  if (op != DMI_OP_WRITE || stats->program_start)
+    return;
+  if (addr == DMI_PROGBUF0 && (data & 0xfff0707f) == 0x7b101073)
+    stats->dpc_written = true;
+  else if (addr == DMI_DMCONTROL && (data & DMCONTROL_RESUMEREQ) &&
+           stats->dpc_written) {
+    stats->program_start = sim_now();
+    stats->program_start_cycle = cycle;
+  }
+}
+
+void sim_stats_json(FILE* file, const sim_stats_t* stats, uint64_t cycle,
+                    const char* exit, int code)
+{
+  double now = sim_now();
+  double sim = now - stats->built;
+  double loaded = stats->program_start ? stats->program_start : now;
+
+  fprintf(file, "{\n");
+  if (exit)
+    fprintf(file, "  \"exit\": \"%s\",\n  \"exit_code\": %d,\n", exit, code);
+  fprintf(file, "  \"cycles\": %lu,\n", (unsigned long)cycle);
+  fprintf(file, "  \"wall_seconds\": %.6f,\n", now - stats->start);
+  fprintf(file, "  \"cycles_per_second\": %.1f,\n", sim > 0 ? cycle / sim : 0.0);
+  if (stats->program_start)
+    fprintf(file, "  \"program_start_cycle\": %lu,\n",
+            (unsigned long)stats->program_start_cycle);
+  else
+    fprintf(file, "  \"program_start_cycle\": null,\n");
+
+  // Phases: construct the model (and restore or preload it), reset, load the
+  // program through the DTM, run it
+  fprintf(file, "  \"phases\": {\n");
+  fprintf(file, "    \"init\": %.6f,\n", stats->built - stats->start);
+  fprintf(file, "    \"reset\": %.6f,\n", stats->reset_done - stats->built);
+  fprintf(file, "    \"load\": %.6f,\n", loaded - stats->reset_done);
+  fprintf(file, "    \"run\": %.6f\n", now - loaded);
+  fprintf(file, "  },\n");
+
+  // Split of the simulation loop
+  fprintf(file, "  \"time\": {\n");
+  fprintf(file, "    \"model\": %.6f,\n", stats->eval - stats->dtm - stats->jtag);
+  fprintf(file, "    \"dtm\": %.6f,\n", stats->dtm);
+  fprintf(file, "    \"jtag\": %.6f,\n", stats->jtag);
+  fprintf(file, "    \"trace\": %.6f,\n", stats->trace);
+  fprintf(file, "    \"other\": %.6f\n", sim - stats->eval - stats->trace);
+  fprintf(file, "  },\n");
+  fprintf(file, "  \"dmi_requests\": %lu,\n", (unsigned long)stats->dmi_reqs);
+  fprintf(file, "  \"fast_forward_cycles\": %lu\n", (unsigned long)stats->skipped);
+  fprintf(file, "}\n");
+  fflush(file);
+}
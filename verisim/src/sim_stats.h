@@ -0,0 +1,49 @@
+#ifndef SIM_STATS_H
+#define SIM_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Where the wall clock time of a run goes, for --stats-json. The emulator
+// times the phases of the run and each tile->eval(); SimDTM.cc and
+// SimJTAG.cc time the DTM and JTAG ticks, which run from inside eval() as
+// DPI calls, so the model's own share is what remains of the eval time.
+struct sim_stats_t
+{
+  double start;          // process start
+  double built;          // model constructed, restored and preloaded
+  double reset_done;     // end of reset
+  double program_start;  // hart resumed at the program's entry point
+  uint64_t program_start_cycle;
+
+  double eval;   // in tile->eval(), including the two below
+  double dtm;    // in dtm->tick()
+  double jtag;   // in jtag->tick()
+  double trace;  // in tfp->dump()
+  uint64_t dmi_reqs;
+  uint64_t skipped;  // cycles fast-forwarded over
+
+  bool dpc_written;
+};
+
+// NULL unless --stats-json (or --progress) asked for timing
+extern sim_stats_t* sim_stats;
+
+static inline double sim_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Watch a DMI request of the DTM for the resume that starts the program
+void sim_stats_dmi(sim_stats_t* stats, int addr, int op, uint32_t data,
+                   uint64_t cycle);
+
+// Write the statistics as of cycle as a JSON object. exit is the reason the
+// run ended ("success", "dtm", "jtag" or "timeout"), or NULL while running.
+void sim_stats_json(FILE* file, const sim_stats_t* stats, uint64_t cycle,
+                    const char* exit, int code);
+
+#endif
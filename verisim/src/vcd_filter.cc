@@ -0,0 +1,194 @@
+#include "vcd_filter.h"
+
+#include <string.h>
+#include <sstream>
+
+static std::vector<std::string> split(const std::string& s, char sep)
+{
+  std::vector<std::string> out;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, sep)) {
+    if (!item.empty())
+      out.push_back(item);
+  }
+  return out;
+}
+
+// VerilatedVcd numbers signals with base-94 codes of the printable characters
+static size_t decode(const char* code, const char* end)
+{
+  size_t id = 0;
+  for (; code < end; code++)
+    id = id * 94 + (*code - '!');
+  return id;
+}
+
+vcd_filter_t::vcd_filter_t(const char* scopes, int depth)
+  : depth(depth), in_header(true)
+{
+  if (scopes)
+    this->scopes = split(scopes, ',');
+}
+
+// Whether a signal in the scope path is kept. root is set to the length of
+// the path of the outermost selected scope it lies in.
+bool vcd_filter_t::selected(const std::vector<std::string>& path, size_t& root) const
+{
+  if (scopes.empty()) {
+    root = 1;
+  } else {
+    for (root = 1; root <= path.size(); root++) {
+      for (const std::string& scope : scopes) {
+        std::vector<std::string> want = split(scope, '.');
+        if (want.empty() || want.size() > root)
+          continue;
+        size_t i = 0;
+        while (i < want.size() && want[i] == path[root - want.size() + i])
+          i++;
+        if (i == want.size())
+          goto found;
+      }
+    }
+    return false;
+  }
+found:
+  return depth <= 0 || path.size() - root < (size_t)depth;
+}
+
+void vcd_filter_t::filter_header(std::string& out)
+{
+  enum { OTHER, SCOPE, UPSCOPE, VAR };
+  struct decl { int kind; size_t begin, end; bool keep; size_t upscope; };
+  std::vector<decl> decls;
+  std::vector<size_t> open;
+  std::vector<std::string> path;
+
+  size_t begin = 0;
+  while (begin < header.size()) {
+    size_t end = header.find('\n', begin) + 1;
+    std::istringstream line(header.substr(begin, end - begin));
+    std::string tok;
+    line >> tok;
+
+    decl d = { OTHER, begin, end, true, 0 };
+    if (tok == "$scope") {
+      std::string type, name;
+      line >> type >> name;
+      d.kind = SCOPE;
+      d.keep = false;
+      open.push_back(decls.size());
+      path.push_back(name);
+    } else if (tok == "$upscope" && !open.empty()) {
+      d.kind = UPSCOPE;
+      d.keep = false;
+      decls[open.back()].upscope = decls.size();
+      open.pop_back();
+      path.pop_back();
+    } else if (tok == "$var") {
+      std::string type, size, code;
+      size_t root;
+      line >> type >> size >> code;
+      d.kind = VAR;
+      d.keep = selected(path, root);
+      if (d.keep) {
+        size_t id = decode(code.data(), code.data() + code.size());
+        if (id >= keep.size())
+          keep.resize(id + 1);
+        keep[id] = true;
+        // Declare the enclosing scopes too
+        for (auto it = open.rbegin(); it != open.rend() && !decls[*it].keep; ++it)
+          decls[*it].keep = true;
+      }
+    }
+    decls.push_back(d);
+    begin = end;
+  }
+
+  for (const decl& d : decls) {
+    if (d.kind == SCOPE && d.keep && d.upscope)
+      decls[d.upscope].keep = true;
+  }
+  for (const decl& d : decls) {
+    if (d.keep)
+      out.append(header, d.begin, d.end - d.begin);
+  }
+  header.clear();
+}
+
+bool vcd_value_change(const char* line, size_t len, size_t& id)
+{
+  const char* code;
+  switch (len ? line[0] : 0) {
+    case 'b': case 'B': case 'r': case 'R':
+      code = (const char*)memchr(line, ' ', len);
+      if (!code)
+        return false;
+      code++;
+      break;
+    case '0': case '1': case 'x': case 'X': case 'z': case 'Z':
+      code = line + 1;
+      break;
+    default:
+      return false;
+  }
+  id = decode(code, line + len);
+  return true;
+}
+
+void vcd_filter_t::filter_line(const char* line, size_t len, std::string& out)
+{
+  size_t id;
+  if (len == 0)
+    return;
+  if (line[0] == '#') {
+    time.assign(line, len);
+    return;
+  }
+  if (!vcd_value_change(line, len, id)) {
+    out.append(line, len).push_back('\n');
+    return;
+  }
+  if (id >= keep.size() || !keep[id])
+    return;
+  if (!time.empty()) {
+    out.append(time).push_back('\n');
+    time.clear();
+  }
+  out.append(line, len).push_back('\n');
+}
+
+void vcd_filter_t::filter(const char* bufp, size_t len, std::string& out)
+{
+  const char* p = bufp;
+  const char* end = bufp + len;
+
+  while (p < end) {
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    if (!nl) {
+      partial.append(p, end - p);
+      break;
+    }
+    const char* line = p;
+    size_t n = nl - p;
+    if (!partial.empty()) {
+      partial.append(p, n);
+      line = partial.data();
+      n = partial.size();
+    }
+    if (in_header) {
+      header.append(line, n).push_back('\n');
+      std::istringstream decl(std::string(line, n));
+      std::string tok;
+      decl >> tok;
+      if (tok == "$enddefinitions") {
+        filter_header(out);
+        in_header = false;
+      }
+    } else {
+      filter_line(line, n, out);
+    }
+    partial.clear();
+    p = nl + 1;
+  }
+}
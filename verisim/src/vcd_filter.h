@@ -0,0 +1,47 @@
+#ifndef VCD_FILTER_H
+#define VCD_FILTER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// If line (without its newline) is a value change, set id to the number of
+// the signal it changes and return true
+bool vcd_value_change(const char* line, size_t len, size_t& id);
+
+// Rewrites the VCD stream of VerilatedVcdC so that it only holds the signals
+// of the selected scopes.
+//
+// scopes is a comma-separated list of instance names or dotted paths, e.g.
+// "creecChain" or "TestHarness.dut.creecChain"; a scope is selected if its
+// full path ends with one of them. depth limits how many levels below a
+// selected scope (or below the top, if there are no scopes) are kept, with
+// 0 meaning no limit.
+//
+// Verilator computes and formats every traced signal regardless, so this
+// saves the output volume (and everything downstream of it), not the cost
+// of the dump itself; --dump-start/--dump-stop bound the latter.
+class vcd_filter_t
+{
+ public:
+  vcd_filter_t(const char* scopes, int depth);
+
+  // Filter len bytes of VCD text, which need not end on a line boundary,
+  // appending what remains to out
+  void filter(const char* bufp, size_t len, std::string& out);
+
+ private:
+  bool selected(const std::vector<std::string>& path, size_t& root) const;
+  void filter_header(std::string& out);
+  void filter_line(const char* line, size_t len, std::string& out);
+
+  std::vector<std::string> scopes;
+  int depth;
+  bool in_header;
+  std::string partial;     // incomplete line carried to the next write()
+  std::string header;      // declarations up to $enddefinitions
+  std::string time;        // timestamp not yet followed by a kept change
+  std::vector<bool> keep;  // by identifier code
+};
+
+#endif
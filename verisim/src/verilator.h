@@ -2,28 +2,60 @@
 #define _ROCKET_VERILATOR_H
 
 #include "verilated_vcd_c.h"
+#include "vcd_filter.h"
+#include "flight_recorder.h"
+#include "async_writer.h"
+#include <functional>
+#include <memory>
 #include <stdlib.h>
 #include <stdio.h>
 
 extern bool verbose;
 extern bool done_reset;
+extern bool dtm_hold;
+extern bool dtm_busy;
+extern unsigned host_interval;
+
+// Run f on the thread the DTM must be created, ticked and deleted on
+void dtm_call(const std::function<void()>& f);
 
 class VerilatedVcdFILE : public VerilatedVcdFile {
  public:
-  VerilatedVcdFILE(FILE* file) : file(file) {}
+  VerilatedVcdFILE(FILE* file, vcd_filter_t* filter = NULL,
+                   flight_recorder_t* recorder = NULL)
+    : file(file), filter(filter), recorder(recorder),
+      writer(file && !recorder ? new async_writer_t(file) : NULL) {}
   ~VerilatedVcdFILE() {}
   bool open(const std::string& name) override {
-    // file should already be open
-    return file != NULL;
+    // file should already be open, unless the trace is only recorded
+    return file != NULL || recorder != NULL;
   }
   void close() override {
-    // file should be closed elsewhere
+    // file should be closed elsewhere, but anything still buffered must be
+    // written before that
+    writer.reset();
   }
   ssize_t write(const char* bufp, ssize_t len) override {
-    return fwrite(bufp, 1, len, file);
+    const char* p = bufp;
+    size_t n = len;
+    if (filter) {
+      filtered.clear();
+      filter->filter(bufp, len, filtered);
+      p = filtered.data();
+      n = filtered.size();
+    }
+    if (recorder)
+      recorder->write(p, n);
+    else if (!writer || !writer->write(p, n))
+      return -1;
+    return len;
   }
  private:
   FILE* file;
+  vcd_filter_t* filter;
+  flight_recorder_t* recorder;
+  std::string filtered;
+  std::unique_ptr<async_writer_t> writer;
 };
 
 #endif